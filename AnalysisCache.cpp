@@ -0,0 +1,123 @@
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "Move.h"
+#include "AnalysisCache.h"
+
+// Start of a cache file. Bump VERSION when the evaluation changes enough
+// that old scores should no longer be trusted.
+struct CacheHeader {
+    char magic[4];  // "CGAC"
+    uint32_t version;
+    uint32_t bits;  // the file has 2^bits slots
+    uint32_t unused;
+};
+
+static const char MAGIC[4] = {'C', 'G', 'A', 'C'};
+static const uint32_t VERSION = 1;
+
+// Layout of Slot::data: score in the low 32 bits, then the move bits, then the depth
+static uint64_t pack(const CachedAnalysis& a){
+  uint64_t depth = a.depth < 0 ? 0 : (a.depth > 255 ? 255 : a.depth);
+  return (uint64_t)(uint32_t)a.score | (uint64_t)a.best.bits() << 32 | depth << 48;
+}
+
+static CachedAnalysis unpack(uint64_t data){
+  CachedAnalysis a;
+  a.score = (int32_t)(uint32_t)data;
+  a.best = Move::from_bits((uint16_t)(data >> 32));
+  a.depth = (int)((data >> 48) & 0xff);
+  return a;
+}
+
+AnalysisCache::~AnalysisCache(){
+  close();
+}
+
+void AnalysisCache::close(){
+  if(_map != nullptr)
+    munmap(_map, _size);
+  if(_fd >= 0)
+    ::close(_fd);
+  _fd = -1;
+  _map = nullptr;
+  _slots = nullptr;
+}
+
+bool AnalysisCache::open(const std::string& path, int bits){
+  close();
+  if(bits < 1 || bits > 30)
+    return false;
+  _fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+  if(_fd < 0)
+    return false;
+
+  //only one process may set up a new file; the others wait and find it ready
+  flock(_fd, LOCK_EX);
+  CacheHeader header;
+  struct stat info;
+  bool ok = fstat(_fd, &info) == 0;
+  if(ok && info.st_size == 0){
+    memcpy(header.magic, MAGIC, sizeof MAGIC);
+    header.version = VERSION;
+    header.bits = bits;
+    header.unused = 0;
+    off_t size = sizeof header + ((off_t)sizeof(Slot) << bits);
+    ok = ftruncate(_fd, size) == 0 && pwrite(_fd, &header, sizeof header, 0) == (ssize_t)sizeof header;
+  }
+  if(ok)
+    ok = pread(_fd, &header, sizeof header, 0) == (ssize_t)sizeof header
+      && memcmp(header.magic, MAGIC, sizeof MAGIC) == 0
+      && header.version == VERSION && header.bits >= 1 && header.bits <= 30
+      && fstat(_fd, &info) == 0
+      && info.st_size == (off_t)(sizeof header + ((off_t)sizeof(Slot) << header.bits));
+  flock(_fd, LOCK_UN);
+  if(!ok){
+    close();
+    return false;
+  }
+
+  _size = info.st_size;
+  _map = mmap(nullptr, _size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+  if(_map == MAP_FAILED){
+    _map = nullptr;
+    close();
+    return false;
+  }
+  _slots = reinterpret_cast<Slot*>(static_cast<char*>(_map) + sizeof header);
+  _mask = ((uint64_t)1 << header.bits) - 1;
+  return true;
+}
+
+bool AnalysisCache::probe(uint64_t key, int depth, CachedAnalysis& found) const{
+  if(_slots == nullptr)
+    return false;
+  const Slot& slot = _slots[key & _mask];
+  uint64_t data = __atomic_load_n(&slot.data, __ATOMIC_RELAXED);
+  uint64_t check = __atomic_load_n(&slot.check, __ATOMIC_RELAXED);
+  if((check ^ data) != key || data == 0) //another position, a torn write, or empty
+    return false;
+  CachedAnalysis a = unpack(data);
+  if(a.depth < depth)
+    return false;
+  found = a;
+  return true;
+}
+
+void AnalysisCache::store(uint64_t key, const CachedAnalysis& analysis){
+  if(_slots == nullptr)
+    return;
+  Slot& slot = _slots[key & _mask];
+  uint64_t old = __atomic_load_n(&slot.data, __ATOMIC_RELAXED);
+  uint64_t old_check = __atomic_load_n(&slot.check, __ATOMIC_RELAXED);
+  if((old_check ^ old) == key && unpack(old).depth > analysis.depth)
+    return; //keep the deeper analysis of the same position
+  uint64_t data = pack(analysis);
+  __atomic_store_n(&slot.data, data, __ATOMIC_RELAXED);
+  __atomic_store_n(&slot.check, key ^ data, __ATOMIC_RELAXED);
+}
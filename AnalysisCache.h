@@ -0,0 +1,70 @@
+#ifndef ANALYSIS_CACHE_H
+#define ANALYSIS_CACHE_H
+
+#include <string>
+#include <cstdint>
+#include "Move.h"
+
+// The engine's answer for one position
+struct CachedAnalysis {
+    Move best;   // best move found
+    int score;   // centipawns for the player to move
+    int depth;   // plies searched
+};
+
+// Position analyses kept in a memory-mapped file, so they outlive the
+// process and every process on the host that maps the same file shares
+// them. The file is a 16-byte header followed by 2^bits slots of two
+// 64-bit words. A slot holds the analysis packed into one word and the
+// position key xor'ed with it in the other, so a reader that catches a
+// slot half written by another process sees a key mismatch and a miss
+// rather than a wrong answer. No locks are taken after the file is set up.
+class AnalysisCache {
+
+public:
+
+    // Slots in a new cache file: 2^20 slots make a 16 MB file
+    static const int DEFAULT_BITS = 20;
+
+    AnalysisCache() : _fd(-1), _map(nullptr), _size(0), _slots(nullptr), _mask(0) {}
+
+    // Unmaps and closes the file
+    ~AnalysisCache();
+
+    AnalysisCache(const AnalysisCache&) = delete;
+    AnalysisCache& operator=(const AnalysisCache&) = delete;
+
+    // Map the cache file at path, creating it with 2^bits slots if it is
+    // missing or empty. An existing file keeps its own size. Returns false
+    // if the file can't be opened or mapped, or is not an analysis cache.
+    bool open(const std::string& path, int bits = DEFAULT_BITS);
+
+    // Return true if a file is mapped
+    bool is_open() const { return _slots != nullptr; }
+
+    // Look up the position with the given key. Returns true and fills
+    // found if the cache holds an analysis of at least depth plies.
+    bool probe(uint64_t key, int depth, CachedAnalysis& found) const;
+
+    // Keep an analysis of the position with the given key. It replaces a
+    // different position in its slot, or a shallower analysis of the same one.
+    void store(uint64_t key, const CachedAnalysis& analysis);
+
+private:
+
+    struct Slot {
+        uint64_t check; // key ^ data
+        uint64_t data;  // score, move and depth
+    };
+
+    int _fd;
+    void* _map;
+    size_t _size;   // bytes mapped
+    Slot* _slots;
+    uint64_t _mask; // number of slots - 1
+
+    void close();
+
+};
+
+#endif // ANALYSIS_CACHE_H
@@ -0,0 +1,246 @@
+#include <string>
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <cstdlib>
+#include <exception>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "Game.h"
+#include "ChessGame.h"
+#include "Search.h"
+#include "ThreadPool.h"
+#include "Variants.h"
+#include "Prompts.h"
+#include "Batch.h"
+
+using std::string;
+using std::vector;
+using std::ostream;
+using std::endl;
+
+static bool is_directory(const string& path){
+  struct stat info;
+  return stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+}
+
+static bool is_file(const string& path){
+  struct stat info;
+  return stat(path.c_str(), &info) == 0 && S_ISREG(info.st_mode);
+}
+
+bool BatchAnalysis::add_path(const string& path){
+  vector<string> files;
+  if(is_file(path))
+    files.push_back(path);
+  else if(is_directory(path)){
+    DIR* dir = opendir(path.c_str());
+    if(dir == nullptr)
+      return false;
+    while(struct dirent* item = readdir(dir)){
+      string file = path + "/" + item->d_name;
+      if(is_file(file))
+	files.push_back(file);
+    }
+    closedir(dir);
+    std::sort(files.begin(), files.end());
+  }
+  else
+    return false;
+
+  for(size_t i = 0; i < files.size(); i++){
+    BatchEntry entry = {files[i], 0, false, 0, 0, false, "", 0, 0, 0};
+    _entries.push_back(entry);
+  }
+  return true;
+}
+
+void BatchAnalysis::analyze(BatchEntry& entry) const{
+  entry.game = detect_game(entry.file);
+  if(entry.game == 0)
+    return;
+  ChessGame* game = nullptr;
+  try {
+    game = create_game(entry.game, entry.file);
+  }
+  catch(std::exception& e){
+    return;
+  }
+  entry.loaded = true;
+  entry.turn = game->turn();
+  entry.status = game->outcome();
+  if(entry.status == 0){ //only unfinished games have a best move
+    Search* search = Search::for_game(*game);
+    SearchLimits limits(_depth, _nodes);
+    limits.cache = _cache;
+    SearchResult result = search->run(limits);
+    delete search;
+    entry.found = result.found;
+    if(result.found)
+      entry.best = game->move_text(result.best);
+    entry.score = result.score;
+    entry.depth = result.depth;
+    entry.nodes = result.nodes;
+  }
+  delete game;
+}
+
+void BatchAnalysis::run(){
+  ThreadPool pool(_threads);
+  for(size_t i = 0; i < _entries.size(); i++){
+    BatchEntry* entry = &_entries[i];
+    pool.submit([this, entry](int){ analyze(*entry); });
+  }
+  pool.wait();
+}
+
+// Short name of how a game stands, for the report
+static const char* status_name(const BatchEntry& entry){
+  if(entry.game == 0)
+    return "unknown_game";
+  if(!entry.loaded)
+    return "load_failure";
+  switch(entry.status){
+  case CHECKMATE: return "checkmate";
+  case STALEMATE: return "stalemate";
+  case DRAW: return "draw";
+  case GAME_WIN: return "hill";
+  }
+  return "playing";
+}
+
+// Player to move on the given turn, as the saved games count turns
+static const char* to_move(const BatchEntry& entry){
+  if(!entry.loaded)
+    return "";
+  return (entry.turn % 2) ? "white" : "black";
+}
+
+// Quote a CSV field if it needs it
+static string csv_field(const string& text){
+  if(text.find_first_of(",\"\n") == string::npos)
+    return text;
+  string quoted = "\"";
+  for(size_t i = 0; i < text.size(); i++){
+    if(text[i] == '"')
+      quoted += '"';
+    quoted += text[i];
+  }
+  return quoted + "\"";
+}
+
+// Quote a JSON string
+static string json_string(const string& text){
+  string quoted = "\"";
+  for(size_t i = 0; i < text.size(); i++){
+    char c = text[i];
+    if(c == '"' || c == '\\'){
+      quoted += '\\';
+      quoted += c;
+    }
+    else if((unsigned char)c < 0x20){
+      const char* hex = "0123456789abcdef";
+      quoted += "\\u00";
+      quoted += hex[(c >> 4) & 0xf];
+      quoted += hex[c & 0xf];
+    }
+    else
+      quoted += c;
+  }
+  return quoted + "\"";
+}
+
+void BatchAnalysis::write_csv(ostream& out) const{
+  out << "file,game,turn,to_move,status,best_move,score,depth,nodes" << endl;
+  for(size_t i = 0; i < _entries.size(); i++){
+    const BatchEntry& e = _entries[i];
+    out << csv_field(e.file) << ',' << game_token(e.game) << ',';
+    if(e.loaded)
+      out << e.turn;
+    out << ',' << to_move(e) << ',' << status_name(e) << ',' << e.best << ',';
+    if(e.found)
+      out << e.score << ',' << e.depth << ',' << e.nodes;
+    else
+      out << ",,";
+    out << '\n';
+  }
+  out.flush();
+}
+
+void BatchAnalysis::write_json(ostream& out) const{
+  out << "[\n";
+  for(size_t i = 0; i < _entries.size(); i++){
+    const BatchEntry& e = _entries[i];
+    out << "  {\"file\": " << json_string(e.file)
+	<< ", \"game\": " << json_string(game_token(e.game))
+	<< ", \"status\": " << json_string(status_name(e));
+    if(e.loaded)
+      out << ", \"turn\": " << e.turn << ", \"to_move\": " << json_string(to_move(e));
+    if(e.found)
+      out << ", \"best_move\": " << json_string(e.best) << ", \"score\": " << e.score
+	  << ", \"depth\": " << e.depth << ", \"nodes\": " << e.nodes;
+    out << (i + 1 < _entries.size() ? "},\n" : "}\n");
+  }
+  out << "]" << endl;
+}
+
+int BatchAnalysis::main(const vector<string>& args){
+  bool json = false;
+  int depth = 3;
+  long nodes = 200000;
+  int threads = ThreadPool::hardware_threads();
+  string output, cache_path;
+  vector<string> paths;
+  for(size_t i = 0; i < args.size(); i++){
+    bool has_value = i + 1 < args.size();
+    if(args[i] == "--json")
+      json = true;
+    else if(args[i] == "--depth" && has_value)
+      depth = std::atoi(args[++i].c_str());
+    else if(args[i] == "--nodes" && has_value)
+      nodes = std::atol(args[++i].c_str());
+    else if(args[i] == "--threads" && has_value)
+      threads = std::atoi(args[++i].c_str());
+    else if(args[i] == "--out" && has_value)
+      output = args[++i];
+    else if(args[i] == "--cache" && has_value)
+      cache_path = args[++i];
+    else
+      paths.push_back(args[i]);
+  }
+
+  BatchAnalysis batch(depth, nodes, threads);
+  for(size_t i = 0; i < paths.size(); i++){
+    if(!batch.add_path(paths[i]))
+      std::cerr << "Skipping " << paths[i] << ": not a file or directory\n";
+  }
+  if(batch.size() == 0){
+    std::cerr << "Usage: play batch [--json] [--depth N] [--nodes N] [--threads N] [--cache FILE] [--out FILE] <file or directory>...\n";
+    return 1;
+  }
+  AnalysisCache cache;
+  if(!cache_path.empty()){
+    if(!cache.open(cache_path)){
+      std::cerr << "Can't use " << cache_path << " as an analysis cache\n";
+      return 1;
+    }
+    batch.use_cache(&cache);
+  }
+  batch.run();
+
+  std::ofstream file;
+  if(!output.empty()){
+    file.open(output);
+    if(!file.is_open()){
+      Prompts::save_failure();
+      return 1;
+    }
+  }
+  ostream& out = output.empty() ? std::cout : file;
+  if(json)
+    batch.write_json(out);
+  else
+    batch.write_csv(out);
+  return 0;
+}
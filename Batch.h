@@ -0,0 +1,69 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include "AnalysisCache.h"
+
+// One analysed save file
+struct BatchEntry {
+    std::string file;
+    int game;           // GameName, 0 if the header is not recognised
+    bool loaded;        // false if the file could not be loaded
+    int turn;
+    int status;         // outcome() of the loaded game
+    bool found;         // whether a best move was found
+    std::string best;   // best move as typed by players
+    int score;          // centipawns for the player to move
+    int depth;
+    long nodes;
+};
+
+// Batch analysis of saved games: every file is loaded as the variant named
+// in its header and searched within the given limits. Files are spread over
+// a ThreadPool, one task per file, and reported in the order given.
+class BatchAnalysis {
+
+public:
+
+    BatchAnalysis(int depth, long nodes, int threads) :
+        _depth(depth), _nodes(nodes), _threads(threads), _cache(nullptr) {}
+
+    // Answer positions from cache where it can, and add new answers to it
+    void use_cache(AnalysisCache* cache) { _cache = cache; }
+
+    // Add a save file, or every regular file in a directory (sorted by name).
+    // Returns false if path is neither.
+    bool add_path(const std::string& path);
+
+    // Number of files queued
+    size_t size() const { return _entries.size(); }
+
+    // Load and analyse all queued files
+    void run();
+
+    // Write the results as CSV with a header line
+    void write_csv(std::ostream& out) const;
+
+    // Write the results as a JSON array of objects
+    void write_json(std::ostream& out) const;
+
+    // Command-line entry: play batch [--json] [--depth N] [--nodes N]
+    // [--threads N] [--cache FILE] [--out FILE] <file or directory>...
+    static int main(const std::vector<std::string>& args);
+
+private:
+
+    int _depth;
+    long _nodes;
+    int _threads;
+    AnalysisCache* _cache;
+    std::vector<BatchEntry> _entries;
+
+    // Load and search one entry; runs on a worker thread
+    void analyze(BatchEntry& entry) const;
+
+};
+
+#endif // BATCH_H
@@ -0,0 +1,33 @@
+#include <cstdint>
+#include "BoardState.h"
+
+// glibc's default generator: x[i] = x[i-3] + x[i-31], with the first 31
+// values seeded by a Lehmer generator, values 31..33 copied from 0..2,
+// and the first 310 results thrown away. Each result drops the low bit.
+void GhostRandom::seed(uint32_t seed){
+  const int WARMUP = 344; //31 seeded values, 3 copies and 310 discarded results
+  int32_t r[WARMUP];
+  r[0] = seed == 0 ? 1 : seed;
+  for(int i = 1; i < 31; i++){
+    //16807 * r[i-1] % (2^31 - 1), without overflowing
+    int32_t hi = r[i - 1] / 127773;
+    int32_t lo = r[i - 1] % 127773;
+    int32_t word = 16807 * lo - 2836 * hi;
+    r[i] = word < 0 ? word + 2147483647 : word;
+  }
+  for(int i = 31; i < 34; i++)
+    r[i] = r[i - 31];
+  for(int i = 34; i < WARMUP; i++)
+    r[i] = (int32_t)((uint32_t)r[i - 31] + (uint32_t)r[i - 3]);
+  for(int i = 0; i < 31; i++)
+    _ring[(WARMUP - 31 + i) % 31] = r[WARMUP - 31 + i];
+  _index = WARMUP % 31;
+}
+
+int GhostRandom::next(){
+  //_ring[_index] holds x[i-31] and is replaced by x[i]
+  uint32_t value = _ring[_index] + _ring[(_index + 28) % 31];
+  _ring[_index] = value;
+  _index = (_index + 1) % 31;
+  return value >> 1;
+}
@@ -0,0 +1,72 @@
+#ifndef BOARD_STATE_H
+#define BOARD_STATE_H
+
+#include <cstdint>
+#include "Enumerations.h"
+
+// Number of position hashes a game remembers for repetition detection.
+// A draw is declared after 100 plies without a capture or pawn move, so
+// older positions never matter.
+const int HISTORY_SIZE = 128;
+
+
+// The random numbers that move the ghost in Spooky Chess, kept per game as
+// plain values so they are copied with the position. Produces the same
+// sequence as glibc's rand() after srand(seed), so saved games and journals
+// written when the ghost used rand() replay unchanged.
+class GhostRandom {
+
+public:
+
+    // Start the sequence for seed, like srand(seed)
+    void seed(uint32_t seed);
+
+    // Return the next number in [0, RAND_MAX], like rand()
+    int next();
+
+private:
+
+    // The last 31 values of the additive feedback sequence
+    uint32_t _ring[31];
+
+    // Index of the next value in _ring
+    int _index;
+
+};
+
+
+// A complete position as plain values: it can be copied with memcpy, kept
+// as an undo snapshot or handed to another thread, and loaded into a game
+// of the same variant with Game::import_state in constant time.
+struct BoardState {
+
+    // Boards of up to 64 squares are supported
+    static const int SQUARES = 64;
+
+    // Code of an empty square
+    static const int8_t EMPTY = -1;
+
+    // Return the code stored for a piece: owner * 8 + piece type
+    static int8_t code(int piece_type, Player owner) { return (int8_t)(owner * 8 + piece_type); }
+
+    // Game
+    int8_t squares[SQUARES];  // piece code per 1D board index
+    uint8_t width, height;
+    int32_t turn;
+    int32_t king_square[2];
+    uint64_t hash;            // Zobrist hash of the pieces
+    uint64_t pawn_hash;       // Zobrist hash of the pawns
+
+    // ChessGame
+    int32_t halfmove;
+    int32_t history_count;
+    uint64_t history[HISTORY_SIZE];
+
+    // SpookyChess
+    int32_t ghost_position;
+    int32_t num_calls;
+    GhostRandom random;
+
+};
+
+#endif // BOARD_STATE_H
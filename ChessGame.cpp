@@ -6,9 +6,15 @@
 #include <string>
 #include <exception>
 #include <cctype>
+#include <algorithm>
+#include <memory>
 #include "Game.h"
 #include "ChessGame.h"
 #include "Prompts.h"
+#include "Engine.h"
+#include "Hint.h"
+#include "Timeline.h"
+#include "Spectator.h"
 
 using std::ofstream;
 using std::string;
@@ -62,6 +68,29 @@ ChessGame::ChessGame(const std::string filename, int type) : Game() {
   return;
 }
 
+// Copy another game. Only the factories are set up anew, everything else is copied.
+ChessGame::ChessGame(const ChessGame& other) :
+  Game(other), _history_count(other._history_count), _halfmove(other._halfmove), _journal(nullptr) {
+  initialize_factories();
+  std::copy(other._history, other._history + HISTORY_SIZE, _history);
+}
+
+void ChessGame::export_state(BoardState& state) const {
+  Game::export_state(state);
+  state.halfmove = _halfmove;
+  state.history_count = _history_count;
+  std::copy(_history, _history + HISTORY_SIZE, state.history);
+}
+
+bool ChessGame::import_state(const BoardState& state) {
+  if(!Game::import_state(state))
+    return false;
+  _halfmove = state.halfmove;
+  _history_count = state.history_count;
+  std::copy(state.history, state.history + HISTORY_SIZE, _history);
+  return true;
+}
+
 //Save current state of game to a file
 void ChessGame::save_game(){
   Prompts::save_game();//Ask user for filename to save
@@ -77,6 +106,7 @@ void ChessGame::save_game(){
   file << _turn << endl; //prints turn number
   save_piece_state(file); //calss function that saves the pieces in the vector to file
   file.close();
+  snapshot_saved(name);
   Prompts::save_success();
 }
 
@@ -88,11 +118,28 @@ void ChessGame::run(){
   std::getline(cin, input);
   system("clear");
   if(check(opponent()))Prompts::check(opponent());
+  Precompute precompute(*this);
+  _precompute = &precompute;
+  HintSearch hints(*this, _cache);
+  Timeline timeline;
+  timeline.start(*this);
+  _timeline = &timeline;
   
   //main user interface
   while(true){
+    if(_clock.enabled())
+      Prompts::clock(_clock.remaining(WHITE), _clock.remaining(BLACK));
     Prompts::player_prompt(player_turn(), _turn); //prompts for user input
-    std::getline(cin, input); //get user input
+    _clock.start(player_turn());
+    bool engine_turn = _engine != nullptr && player_turn() == _engine->side();
+    if(engine_turn)
+      input = move_text(_engine->choose(*this)); //the engine's move, as if typed
+    else {
+      precompute.start(*this); //work out the replies while the player types
+      if(_engine != nullptr)
+	_engine->ponder(*this); //and the engine's answer to the likely one
+      std::getline(cin, input); //get user input
+    }
     lowerCase(input); //case insensitive input, so converts all inputs to lower case
     //Check for non-move command
     if(input == "board"){
@@ -106,13 +153,61 @@ void ChessGame::run(){
     }
     else if(input == "q") //quits game
       break;
+    else if(input == "hint" || input.compare(0, 5, "hint ") == 0){ //best move within a latency cap
+      int latency = input.size() > 5 ? std::atoi(input.c_str() + 5) : _hint_latency;
+      SearchResult hint = hints.hint(*this, latency > 0 ? latency : HintSearch::DEFAULT_LATENCY);
+      system("clear");
+      if(hint.found)
+	Prompts::hint(move_text(hint.best), hint.depth);
+    }
+    else if(input == "takeback"){ //against the engine, its reply is taken back too
+      int plies = _engine != nullptr ? 2 : 1;
+      system("clear");
+      if(take_back(plies)){
+	_clock.restart(player_turn()); //the side to move now, with no increment
+	Prompts::taken_back(plies);
+	if(_spectators != nullptr)
+	  _spectators->publish(*this);
+      }
+      else
+	Prompts::no_takeback();
+    }
+    else if(input.compare(0, 7, "review ") == 0){ //show an earlier position, then carry on
+      int ply = std::atoi(input.c_str() + 7);
+      std::unique_ptr<ChessGame> view(clone());
+      system("clear");
+      if(timeline.seek(*view, ply)){
+	Prompts::review(ply, timeline.plies());
+	view->_board_on = true;
+	view->draw_board();
+      }
+      else
+	Prompts::no_review(timeline.plies());
+      continue;
+    }
     else if(input == "forfeit"){ //forfeit, propmts win and game_over then exits
       Prompts::win(opponent(), _turn);
       Prompts::game_over();
       break;
     }
     else {
+      int turn = _turn;
+      Player mover = player_turn();
       int status = update_board(input); //attempt to make move
+      if(_journal != nullptr && !_journal->is_open()){ //a write failed
+	Prompts::journal_failure();
+	_journal = nullptr;
+      }
+      if(engine_turn)
+	Prompts::engine_move(mover, input);
+      if(_turn != turn && _spectators != nullptr)
+	_spectators->publish(*this); //the whole turn, ghost included
+      if(_turn != turn && !_clock.stop()){ //the move came too late
+	Prompts::out_of_time(mover);
+	Prompts::win(opponent(), _turn);
+	Prompts::game_over();
+	break;
+      }
       //prints correct msg
       if(status == GAME_OVER){
 	Prompts::game_over();
@@ -126,6 +221,26 @@ void ChessGame::run(){
     }
     draw_board();
   }
+  if(_journal != nullptr && !_journal->flush()) //nothing may be left behind in memory
+    Prompts::journal_failure();
+  _precompute = nullptr;
+  _timeline = nullptr;
+}
+
+// Seek the timeline to the earlier ply and make it the end of the game. The
+// moves replayed by seek must not be recorded again, so the timeline is
+// detached meanwhile.
+bool ChessGame::take_back(int plies){
+  if(_timeline == nullptr || _journal != nullptr || plies < 1 || plies > _timeline->plies())
+    return false;
+  Timeline* timeline = _timeline;
+  int ply = timeline->plies() - plies;
+  _timeline = nullptr;
+  bool done = timeline->seek(*this, ply);
+  _timeline = timeline;
+  if(done)
+    timeline->truncate(ply);
+  return done;
 }
 
 // update board and make move for Chess and King of Hill Chess
@@ -157,7 +272,9 @@ int ChessGame::try_move(string input){
     return PARSE_ERROR;
   
   //calls make_move and print out appropriate error messages
-  int status = make_move(Position(x_i-'a',y_i-'1'), Position(x_f-'a', y_f-'1'));
+  Position start(x_i-'a', y_i-'1'), end(x_f-'a', y_f-'1');
+  uint64_t key = reply_key();
+  int status = make_move(start, end);
   switch(status){
   case MOVE_ERROR_OUT_OF_BOUNDS: Prompts::out_of_bounds();
     break;
@@ -178,11 +295,16 @@ int ChessGame::try_move(string input){
     _turn++;
   else
     return status; //exit if move is illegal
+
+  //look up the mate and check tests if they were done while the player typed
+  const PrecomputedReply* known = nullptr;
+  if(_precompute != nullptr)
+    known = _precompute->find(key, Move(index(start), index(end)));
   
-  if(game_over()) // If game is over
+  if(report_outcome(known ? known->outcome : outcome())) // If game is over
     return GAME_OVER;
   
-  if(check(opponent())){ // Report a check if there is one
+  if(known ? known->check : check(opponent())){ // Report a check if there is one
     Prompts::check(opponent());
     return MOVE_CHECK;
   }
@@ -193,6 +315,20 @@ int ChessGame::try_move(string input){
 }
 
 
+// Inverse of the parsing in try_move
+string ChessGame::move_text(Position start, Position end){
+  string text = "a1 a1";
+  text[0] += start.x;
+  text[1] += start.y;
+  text[3] += end.x;
+  text[4] += end.y;
+  return text;
+}
+
+string ChessGame::move_text(Move m) const{
+  return move_text(pos(m.from()), pos(m.to()));
+}
+
 // Check if move is valid but doesn't make the actual move, return status of move
 // return value > 0 if successful, value < 0 otherwise
 int ChessGame::valid_move(Position start, Position end){
@@ -241,134 +377,491 @@ int ChessGame::valid_move(Position start, Position end){
 // Detect a check by a passed in player
 // Return true if the player is checking its opponent
 bool ChessGame::check(Player cur_player){
-  // turn has already been incremented after a move is made.
-  // Since we are calling valid_move, which needs to know the identity of the previous player
-  // We decrement _turn temporarily in this function for valid_move to work properly
-  _turn--;
-  Position king; //get king position of other player
-  for(unsigned int i = 0; i < _pieces.size(); i++){
-    if(_pieces[i] != nullptr && _pieces[i]->owner() != cur_player && _pieces[i]->piece_type() == KING_ENUM ){
-      king = pos(i); //convert from index to position
-    }
-  }
-  for(unsigned int i = 0; i < _pieces.size(); i++){ //loop through all pieces to see if they can capture king
-    if(_pieces[i] == nullptr || _pieces[i]->owner() != cur_player)
-      continue;
-    if(valid_move(pos(i), king) > 0){ //a valid move to king is possible
-      _turn++; //restore original turn
-      return true; //is checking
-    }
-  }
-  _turn++; //restore original turn
-  return false;
+  if(cur_player == NO_ONE)
+    return false;
+  int king = _king_square[cur_player == WHITE ? BLACK : WHITE]; //king of the other player
+  if(king < 0)
+    return false;
+  return square_attacked(king, cur_player);
 }
 
-
 // Perform a move from the start Position to the end Position                   
 // The method returns an integer with the status                                
 // > 0 is SUCCESS, < 0 is failure    
 int ChessGame::make_move(Position start, Position end) {
-  bool in_check = check(opponent()); //true if currently in check, used to print out correct check handling msg
-  
-  int status = valid_move(start, end); //move status of attempted move
+  if(_timeline != nullptr)
+    _timeline->checkpoint(*this); //the position the move is played from
+  MoveRecord record;
+  int status = apply_move(start, end, record);
   if(status < 0) //if move status is invalid, exits
     return status;
+  record_played(record.move);
+  return status;
+}
 
-  Piece* p = _pieces[index(start)]; //get piece at start pos
-  if(status == SUCCESS){ //move piece with no capture
-    _pieces[index(start)] = nullptr; //remove piece from starting pos
-    _pieces[index(end)] = p;
-    if(check(opponent())){ //revert the move if the move results in check
-      _pieces[index(start)] = p;
-      _pieces[index(end)] = nullptr;
-      if(in_check) //prints out specific msg for disallowed move
-	return MOVE_ERROR_MUST_HANDLE_CHECK; //if previously in check
-      return MOVE_ERROR_CANT_EXPOSE_CHECK; //if previously not in check
-    }
+// Hand a move just made to the journal and the timeline
+void ChessGame::record_played(Move m) {
+  if(_journal != nullptr)
+    _journal->record_move(m);
+  if(_timeline != nullptr)
+    _timeline->record_move(m);
+}
+
+// The second half of make_move and replay_move, the checks being done
+int ChessGame::play_checked_turn(Move m, int status) {
+  if(_timeline != nullptr)
+    _timeline->checkpoint(*this);
+  MoveRecord record;
+  play_move(encode_move(m.from(), m.to()), record);
+  record_played(record.move);
+  _turn++;
+  return status;
+}
+
+// Replay a recorded move the way try_move plays it, minus the messages
+int ChessGame::replay_move(Move m) {
+  if(m.from() >= (int)_pieces.size() || m.to() >= (int)_pieces.size())
+    return MOVE_ERROR_OUT_OF_BOUNDS;
+  int status = make_move(pos(m.from()), pos(m.to()));
+  if(status > 0)
+    _turn++;
+  return status;
+}
+
+// Validate and play a move, remembering in record what was moved, captured and promoted.
+// Nothing is deleted here, so the caller decides whether the move is kept or taken back.
+int ChessGame::apply_move(Position start, Position end, MoveRecord& record) {
+  int status = check_move(start, end); //move status of attempted move
+  if(status < 0) //if move status is invalid, exits
+    return status;
+  play_move(encode_move(index(start), index(end)), record);
+  return status;   
+}
+
+int ChessGame::check_turn(Move m) {
+  if(m.from() >= (int)_pieces.size() || m.to() >= (int)_pieces.size())
+    return MOVE_ERROR_OUT_OF_BOUNDS;
+  if(outcome() != 0)
+    return MOVE_ERROR_ILLEGAL;
+  return check_move(pos(m.from()), pos(m.to()));
+}
+
+// The move's shape and path, then king safety
+int ChessGame::check_move(Position start, Position end) {
+  int status = valid_move(start, end);
+  if(status < 0)
+    return status;
+
+  //decide king safety from the position's pins and checks, without trying the move
+  LegalMasks masks;
+  compute_masks(masks);
+  if(!legal_target(index(start), index(end), masks)){
+    if(masks.checkers > 0) //prints out specific msg for disallowed move
+      return MOVE_ERROR_MUST_HANDLE_CHECK; //if previously in check
+    return MOVE_ERROR_CANT_EXPOSE_CHECK; //if previously not in check
   }
-  else if(status == MOVE_CAPTURE){ //capturing
-    _pieces[index(start)] = nullptr; //remove piece from starting pos
-    Piece* captured = _pieces[index(end)]; //set a temp pointer to the captured piece
-    _pieces[index(end)] = nullptr;
-    _pieces[index(end)] = p;
-    if(check(opponent())){ //revert the move if it results in check
-      _pieces[index(start)] = p;
-      _pieces[index(end)] = captured;
-      if(in_check) 
-	return MOVE_ERROR_MUST_HANDLE_CHECK;
-      return MOVE_ERROR_CANT_EXPOSE_CHECK;
-    }
-    delete captured; //clean up pointer to captured piece
+  return status;
+}
+
+// Pack a move between two 1D indices, flagging captures and promotions
+Move ChessGame::encode_move(int from, int to) const {
+  int flags = 0;
+  if(_pieces[to] != nullptr)
+    flags |= Move::CAPTURE;
+  const Piece* p = _pieces[from];
+  if(p->piece_type() == PAWN_ENUM){ //pawn to queen on other side
+    int y = to / _width;
+    if((p->owner() == WHITE && y == (int)_height - 1) || (p->owner() == BLACK && y == 0))
+      flags |= Move::PROMOTION;
   }
+  return Move(from, to, flags);
+}
+
+// Move the pieces and update the hash, history and king squares
+void ChessGame::play_move(Move m, MoveRecord& record) {
+  int from = m.from(), to = m.to();
+  Piece* p = _pieces[from]; //get piece at start pos
+  Piece* captured = _pieces[to]; //nullptr unless capturing
+  _pieces[from] = nullptr; //remove piece from starting pos
+  _pieces[to] = p;
+
+  //remember the position being left, and restart the clock on irreversible moves
+  _history[_history_count++ % HISTORY_SIZE] = position_hash();
+  record.halfmove = _halfmove;
+  _halfmove = (captured != nullptr || p->piece_type() == PAWN_ENUM) ? 0 : _halfmove + 1;
+  toggle_hash(p, from);
+  toggle_hash(captured, to);
+  toggle_hash(p, to);
+  remove_material(captured);
+
+  record.move = m;
+  record.moved = p;
+  record.captured = captured;
+  record.promoted = nullptr;
+  if(p->piece_type() == KING_ENUM)
+    _king_square[p->owner()] = to;
   
   // pawn to queen on other side
-  if(p->piece_type() == PAWN_ENUM){
-    if((p->owner() == WHITE && end.y == 7)||(p->owner() == BLACK && end.y == 0)){
-      _pieces[index(end)] = nullptr;
-      init_piece(QUEEN_ENUM, p->owner(), end);
-      delete p; //clean up pointer to the orgirnal pawn
+  if(m.is(Move::PROMOTION)){
+    record.promoted = shared_piece(QUEEN_ENUM, p->owner());
+    _pieces[to] = record.promoted;
+    toggle_hash(p, to);
+    toggle_hash(record.promoted, to);
+    remove_material(p);
+    add_material(record.promoted);
+  }
+}
+
+// Play a move for the engine. Captured pieces are kept in record for undo_move.
+void ChessGame::do_move(Move m, MoveRecord& record) {
+  play_move(m, record);
+  _turn++;
+}
+
+// Take back a move played by do_move, restoring any captured piece
+void ChessGame::undo_move(const MoveRecord& record) {
+  int from = record.move.from(), to = record.move.to();
+  _turn--;
+  _history_count--;
+  _halfmove = record.halfmove;
+  toggle_hash(record.promoted != nullptr ? record.promoted : record.moved, to);
+  toggle_hash(record.captured, to);
+  toggle_hash(record.moved, from);
+  add_material(record.captured);
+  if(record.promoted != nullptr){
+    remove_material(record.promoted);
+    add_material(record.moved);
+  }
+  _pieces[from] = record.moved;
+  _pieces[to] = record.captured;
+  if(record.moved->piece_type() == KING_ENUM)
+    _king_square[record.moved->owner()] = from;
+}
+
+// Steps of the pieces that do not slide, and directions of those that do
+static const int KNIGHT_STEPS[8][2] = {{1,2},{2,1},{2,-1},{1,-2},{-1,-2},{-2,-1},{-2,1},{-1,2}};
+static const int KING_STEPS[8][2] = {{1,0},{1,1},{0,1},{-1,1},{-1,0},{-1,-1},{0,-1},{1,-1}};
+
+// Return the 1D index of the lowest square in a non-empty mask
+static int first_square(uint64_t mask) { return __builtin_ctzll(mask); }
+
+// KING_STEPS alternates straight and diagonal directions
+static bool diagonal_step(int d) { return d % 2 == 1; }
+
+// Return true if a piece of this type slides along the given kind of line
+static bool slides(int piece_type, bool diagonal){
+  return piece_type == QUEEN_ENUM || piece_type == (diagonal ? BISHOP_ENUM : ROOK_ENUM);
+}
+
+// Collect every legal move of the player to move. Pins and checks are worked
+// out once, so no move has to be played to know whether it is legal.
+void ChessGame::legal_moves(MoveList& moves) {
+  moves.clear();
+  LegalMasks masks;
+  compute_masks(masks);
+  for(unsigned int i = 0; i < _pieces.size(); i++){
+    if(_pieces[i] == nullptr || _pieces[i]->owner() != player_turn())
+      continue;
+    uint64_t targets = move_targets(i);
+    if(_pieces[i]->piece_type() == KING_ENUM)
+      targets &= ~masks.attacked;
+    else {
+      targets &= masks.check_mask;
+      if((masks.pinned >> i) & 1)
+	targets &= masks.pin_ray[i];
     }
+    for(; targets != 0; targets &= targets - 1)
+      moves.push(encode_move(i, first_square(targets)));
   }
-  return status;   
 }
 
 // Report whether a mate occurs, either checkmate or stalemate
 // This would essentially result in game_over
 // Return 0 if no mate is detected
 int ChessGame::mate(){
-  bool in_check = check(opponent());
-  bool flag = 1; //whether no move can be made, set to 0 if a move is possible
-  
-  //for each piece of the current player
+  MoveList moves;
+  legal_moves(moves);
+  if(!moves.empty())
+    return 0; //return 0 if no mate detected
+  if(check(opponent()))
+    return CHECKMATE;
+  return STALEMATE;
+}
+
+int ChessGame::occupant(uint64_t mask) const{
+  for(; mask != 0; mask &= mask - 1){
+    int sq = first_square(mask);
+    if(_pieces[sq] != nullptr)
+      return sq;
+  }
+  return -1;
+}
+
+uint64_t ChessGame::slide(int from, int dx, int dy, int ignore) const{
+  uint64_t ray = 0;
+  int x = from % _width + dx;
+  int y = from / _width + dy;
+  while(x >= 0 && y >= 0 && x < (int)_width && y < (int)_height){
+    int sq = y * _width + x;
+    ray |= 1ULL << sq;
+    if(_pieces[sq] != nullptr && sq != ignore)
+      break; //blocked, but the blocker's square is reached
+    x += dx;
+    y += dy;
+  }
+  return ray;
+}
+
+// Add the square (x, y) to mask if it is on the board
+static void add_square(uint64_t& mask, int x, int y, int width, int height){
+  if(x >= 0 && y >= 0 && x < width && y < height)
+    mask |= 1ULL << (y * width + x);
+}
+
+uint64_t ChessGame::attacks(Player p, int ignore) const{
+  uint64_t attacked = 0;
   for(unsigned int i = 0; i < _pieces.size(); i++){
-    if(_pieces[i] == nullptr || _pieces[i]->owner() != player_turn()) //loop through all pieces of current player
+    if(_pieces[i] == nullptr || _pieces[i]->owner() != p)
       continue;
-    //check for all moves to each position on board
-    for(unsigned int j = 0; j < _pieces.size(); j++){
-      if(j==i) continue; //ignore move to same pos
-      int status = valid_move(pos(i), pos(j));
-      if (status == SUCCESS){ 
-	_pieces[j] = _pieces[i];
-	_pieces[i] = nullptr;
-	if(!check(opponent())) //the move can cancel check
-	  flag = 0;
-	_pieces[i] = _pieces[j]; //revert back, we don't actually want to make the move
-	_pieces[j] = nullptr;
-      } 
-      if (status == MOVE_CAPTURE){
-	Piece* tmp = _pieces[j];
-	_pieces[j] = nullptr;
-	_pieces[j] = _pieces[i];
-	_pieces[i] = nullptr; 
-	if(!check(opponent()))
-	  flag = 0; 
-	_pieces[i] = _pieces[j]; //revert back
-	_pieces[j] = tmp;
+    int x = i % _width, y = i / _width;
+    int type = _pieces[i]->piece_type();
+    switch(type){
+    case PAWN_ENUM: { //pawns only attack diagonally forward
+      int dy = (p == WHITE) ? 1 : -1;
+      add_square(attacked, x - 1, y + dy, _width, _height);
+      add_square(attacked, x + 1, y + dy, _width, _height);
+      break;
+    }
+    case KNIGHT_ENUM:
+      for(int d = 0; d < 8; d++)
+	add_square(attacked, x + KNIGHT_STEPS[d][0], y + KNIGHT_STEPS[d][1], _width, _height);
+      break;
+    case KING_ENUM:
+      for(int d = 0; d < 8; d++)
+	add_square(attacked, x + KING_STEPS[d][0], y + KING_STEPS[d][1], _width, _height);
+      break;
+    default: //sliding pieces
+      for(int d = 0; d < 8; d++){
+	if(slides(type, diagonal_step(d)))
+	  attacked |= slide(i, KING_STEPS[d][0], KING_STEPS[d][1], ignore);
       }
     }
   }
-  if(in_check && flag)
-    return CHECKMATE;
-  if(!in_check && flag)
-    return STALEMATE;
-  //return 0 if no mate detected
-  return 0;
+  return attacked;
+}
+
+// Look outwards from sq for a piece of player p that could capture there
+bool ChessGame::square_attacked(int sq, Player p) const{
+  int x = sq % _width, y = sq / _width;
+  uint64_t knights = 0, kings = 0, pawns = 0;
+  for(int d = 0; d < 8; d++){
+    add_square(knights, x + KNIGHT_STEPS[d][0], y + KNIGHT_STEPS[d][1], _width, _height);
+    add_square(kings, x + KING_STEPS[d][0], y + KING_STEPS[d][1], _width, _height);
+  }
+  int dy = (p == WHITE) ? -1 : 1; //an attacking pawn stands one row behind sq
+  add_square(pawns, x - 1, y + dy, _width, _height);
+  add_square(pawns, x + 1, y + dy, _width, _height);
+
+  for(int d = 0; d < 8; d++){
+    uint64_t ray = slide(sq, KING_STEPS[d][0], KING_STEPS[d][1], -1);
+    int blocker = occupant(ray);
+    if(blocker >= 0 && _pieces[blocker]->owner() == p &&
+       slides(_pieces[blocker]->piece_type(), diagonal_step(d)))
+      return true;
+  }
+  for(uint64_t rest = knights | kings | pawns; rest != 0; rest &= rest - 1){
+    int i = first_square(rest);
+    uint64_t bit = 1ULL << i;
+    Piece* piece = _pieces[i];
+    if(piece == nullptr || piece->owner() != p)
+      continue;
+    if(((knights & bit) && piece->piece_type() == KNIGHT_ENUM) ||
+       ((kings & bit) && piece->piece_type() == KING_ENUM) ||
+       ((pawns & bit) && piece->piece_type() == PAWN_ENUM))
+      return true;
+  }
+  return false;
+}
+
+// Find the pieces checking our king and the pieces pinned to it by walking
+// the eight lines out of the king square plus the knight and pawn squares
+void ChessGame::compute_masks(LegalMasks& masks) const{
+  Player us = player_turn(), them = opponent();
+  int king = _king_square[us];
+  masks.attacked = attacks(them, king);
+  masks.pinned = 0;
+  masks.checkers = 0;
+  masks.check_mask = ~0ULL;
+  if(king < 0)
+    return;
+
+  uint64_t evasions = 0; //squares that deal with every check
+  int x = king % _width, y = king / _width;
+  for(int d = 0; d < 8; d++){
+    uint64_t ray = slide(king, KING_STEPS[d][0], KING_STEPS[d][1], -1);
+    int first = occupant(ray); //first piece met on the line
+    if(first < 0)
+      continue;
+    Piece* p = _pieces[first];
+    if(p->owner() == them && slides(p->piece_type(), diagonal_step(d))){
+      masks.checkers++;
+      evasions |= ray;
+    }
+    else if(p->owner() == us){ //look behind our piece for a pinner
+      uint64_t behind = slide(first, KING_STEPS[d][0], KING_STEPS[d][1], -1);
+      int pinner = occupant(behind);
+      if(pinner >= 0 && _pieces[pinner]->owner() == them &&
+	 slides(_pieces[pinner]->piece_type(), diagonal_step(d))){
+	masks.pinned |= 1ULL << first;
+	masks.pin_ray[first] = ray | behind;
+      }
+    }
+  }
+
+  uint64_t knights = 0, pawns = 0;
+  for(int d = 0; d < 8; d++)
+    add_square(knights, x + KNIGHT_STEPS[d][0], y + KNIGHT_STEPS[d][1], _width, _height);
+  int dy = (us == WHITE) ? 1 : -1; //enemy pawns attack from in front of our king
+  add_square(pawns, x - 1, y + dy, _width, _height);
+  add_square(pawns, x + 1, y + dy, _width, _height);
+  for(uint64_t rest = knights | pawns; rest != 0; rest &= rest - 1){
+    int i = first_square(rest);
+    uint64_t bit = 1ULL << i;
+    Piece* p = _pieces[i];
+    if(p == nullptr || p->owner() != them)
+      continue;
+    if(((knights & bit) && p->piece_type() == KNIGHT_ENUM) ||
+       ((pawns & bit) && p->piece_type() == PAWN_ENUM)){
+      masks.checkers++;
+      evasions |= bit;
+    }
+  }
+
+  if(masks.checkers == 1)
+    masks.check_mask = evasions;
+  else if(masks.checkers > 1) //double check, only the king may move
+    masks.check_mask = 0;
+}
+
+bool ChessGame::legal_target(int from, int to, const LegalMasks& masks) const{
+  uint64_t bit = 1ULL << to;
+  if(_pieces[from]->piece_type() == KING_ENUM)
+    return !(masks.attacked & bit);
+  if(!(masks.check_mask & bit))
+    return false;
+  return !((masks.pinned >> from) & 1) || (masks.pin_ray[from] & bit);
+}
+
+// Generate destinations with the same rules as the pieces' valid_move_shape
+// and valid_move: no capturing own pieces or the ghost, pawns capture only
+// diagonally and advance two squares only from their starting row
+uint64_t ChessGame::move_targets(int from) const{
+  Piece* p = _pieces[from];
+  Player us = p->owner();
+  int x = from % _width, y = from / _width;
+  uint64_t targets = 0;
+  switch(p->piece_type()){
+  case PAWN_ENUM: {
+    int dy = (us == WHITE) ? 1 : -1;
+    int ahead = (y + dy) * _width + x;
+    if(y + dy < 0 || y + dy >= (int)_height)
+      return 0;
+    if(_pieces[ahead] == nullptr){
+      targets |= 1ULL << ahead;
+      int start_row = (us == WHITE) ? 1 : (int)_height - 2; //second row from each side
+      int two = ahead + dy * (int)_width;
+      if(y == start_row && _pieces[two] == nullptr)
+	targets |= 1ULL << two;
+    }
+    for(int dx = -1; dx <= 1; dx += 2){
+      if(x + dx < 0 || x + dx >= (int)_width)
+	continue;
+      Piece* victim = _pieces[ahead + dx];
+      if(victim != nullptr && victim->owner() != us && victim->owner() != NO_ONE)
+	targets |= 1ULL << (ahead + dx);
+    }
+    return targets;
+  }
+  case KNIGHT_ENUM:
+    for(int d = 0; d < 8; d++)
+      add_square(targets, x + KNIGHT_STEPS[d][0], y + KNIGHT_STEPS[d][1], _width, _height);
+    break;
+  case KING_ENUM:
+    for(int d = 0; d < 8; d++)
+      add_square(targets, x + KING_STEPS[d][0], y + KING_STEPS[d][1], _width, _height);
+    break;
+  default:
+    for(int d = 0; d < 8; d++){
+      if(slides(p->piece_type(), diagonal_step(d)))
+	targets |= slide(from, KING_STEPS[d][0], KING_STEPS[d][1], -1);
+    }
+  }
+  //remove squares held by own pieces or the ghost
+  for(uint64_t rest = targets; rest != 0; rest &= rest - 1){
+    int sq = first_square(rest);
+    if(_pieces[sq] != nullptr && (_pieces[sq]->owner() == us || _pieces[sq]->owner() == NO_ONE))
+      targets &= ~(1ULL << sq);
+  }
+  return targets;
 }
 
 // Returns true if game is over, print out message about how game ended (check/stale mate)
 // This is different for HillChess due to an added condition
 bool ChessGame::game_over(){
-  if(mate() == CHECKMATE){
+  return report_outcome(outcome());
+}
+
+bool ChessGame::report_outcome(int result){
+  switch(result){
+  case CHECKMATE:
     Prompts::checkmate(opponent()); //Prompts corect msg
     Prompts::win(opponent(), turn()-1);
     return true;
-  }else if(mate() == STALEMATE){
+  case STALEMATE:
     Prompts::stalemate();
     return true;
+  case DRAW:
+    if(fifty_moves())
+      Prompts::fifty_moves();
+    else if(insufficient_material())
+      Prompts::insufficient_material();
+    else
+      Prompts::threefold_repetition();
+    return true;
   }
   return false;
 }
 
+// Mates first, then draws by repetition (third time the position is
+// reached), by the fifty-move rule or for lack of mating material
+int ChessGame::outcome(){
+  int result = mate();
+  if(result != 0)
+    return result;
+  if(repetitions() >= 2 || fifty_moves() || insufficient_material())
+    return DRAW;
+  return 0;
+}
+
+// Compare the current position with the earlier ones since the last
+// irreversible move. Only every other entry can match, since the same
+// player must be to move, so at most 50 hashes are looked at.
+int ChessGame::repetitions() const{
+  uint64_t hash = position_hash();
+  int reach = _halfmove < HISTORY_SIZE ? _halfmove : HISTORY_SIZE;
+  int count = 0;
+  for(int back = 2; back <= reach; back += 2){
+    if(_history[(_history_count - back) % HISTORY_SIZE] == hash)
+      count++;
+  }
+  return count;
+}
+
+uint64_t ChessGame::reply_key() const{
+  uint64_t clocks = (uint64_t)_halfmove << 32 | (uint64_t)repetitions();
+  return position_hash() ^ clocks * 0x9e3779b97f4a7c15ULL;
+}
+
 
 
 // Prepare the game to create pieces to put on the board
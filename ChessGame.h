@@ -2,8 +2,42 @@
 #define CHESS_GAME_H
 
 #include <string>
+#include <vector>
+#include <cstdint>
 #include "Game.h"
+#include "Move.h"
 #include "ChessPiece.h"
+#include "Journal.h"
+#include "Precompute.h"
+
+class EnginePlayer;
+class AnalysisCache;
+class Timeline;
+class SpectatorChannel;
+
+// What decides the legality of the moves of the player to move, computed
+// once per position. Masks are indexed by 1D board index (boards of up to
+// 64 squares). A king move is legal if its target is not attacked; any other
+// move must land on check_mask, and a pinned piece must also stay on its pin ray.
+struct LegalMasks {
+    uint64_t attacked;     // squares the opponent attacks, looking through our king
+    uint64_t check_mask;   // squares that block or capture the checker, all if not in check
+    uint64_t pinned;       // our pieces pinned to our king
+    uint64_t pin_ray[BoardState::SQUARES];  // for a pinned piece, the squares between king and pinner, pinner included
+    int checkers;          // number of opponent pieces giving check
+};
+
+// Everything needed to take back a move played with do_move()
+struct MoveRecord {
+    Move move;
+    Piece* moved;    // the piece that left start
+    Piece* captured; // the piece that stood on end, nullptr if none
+    Piece* promoted; // the queen a pawn turned into, nullptr if none
+    int halfmove;    // halfmove clock before the move
+};
+
+// Plies without a capture or pawn move after which the game is drawn
+const int FIFTY_MOVE_PLIES = 100;
 
 
 class ChessGame : public Game {
@@ -16,12 +50,68 @@ public:
     // Creates game with state indicated in specified file and the game type
     ChessGame(std::string filename, int type);
 
+    // Creates an independent copy of another game, history included
+    ChessGame(const ChessGame& other);
+
+    // Return a new copy of this game of the same variant. Caller owns the result.
+    virtual ChessGame* clone() const { return new ChessGame(*this); }
+
+    // Add the halfmove clock and position history to the exported state
+    virtual void export_state(BoardState& state) const override;
+
+    // Restore the halfmove clock and position history along with the board
+    virtual bool import_state(const BoardState& state) override;
+
     // Main gameplay loop
     void run() override;
 
     // Parse user input for make move
     int try_move(std::string input);
 
+    // Make a move and advance the turn, as try_move does but without
+    // any output. Used to replay journals.
+    int replay_move(Move m);
+
+    // Play a whole turn without any output: the move, then whatever the
+    // variant does between turns. Returns the status of the move.
+    virtual int play_turn(Move m) { return replay_move(m); }
+
+    // Check a move for play_turn without playing it: both squares must be
+    // on the board and a game that is over accepts no move
+    int check_turn(Move m);
+
+    // Play a whole turn, as play_turn does, for a move check_turn accepted
+    // with status, without checking it again. Returns status.
+    virtual int play_checked_turn(Move m, int status);
+
+    // Record every move from now on in journal (not owned), or stop with nullptr
+    void attach_journal(Journal* journal) { _journal = journal; }
+
+    // Let engine (not owned) play its side in run, or stop with nullptr
+    void attach_engine(EnginePlayer* engine) { _engine = engine; }
+
+    // Look hints and the engine's searches up in and add them to cache (not
+    // owned), or stop with nullptr
+    void attach_cache(AnalysisCache* cache) { _cache = cache; }
+    AnalysisCache* cache() const { return _cache; }
+
+    // Answer hints within ms, 0 for HintSearch's default
+    void set_hint_latency(int ms) { _hint_latency = ms; }
+
+    // Send every turn played in run to channel (not owned), or stop with nullptr
+    void attach_spectators(SpectatorChannel* channel) { _spectators = channel; }
+
+    // Moves played in run so far, nullptr outside run
+    const Timeline* timeline() const { return _timeline; }
+
+    // Take back the last plies moves played in run. Returns false if there
+    // aren't that many, or if the game is journaled, as a journal can only grow.
+    bool take_back(int plies);
+
+    // Write a move the way players type it, e.g. "e2 e4"
+    static std::string move_text(Position start, Position end);
+    std::string move_text(Move m) const;
+
     virtual int update_board(std::string input);
     
     
@@ -31,29 +121,144 @@ public:
 
     // Check if move is valid, return status of move
     int valid_move(Position start, Position end);
+
+    // Check a move fully, king safety included, without playing it.
+    // Returns the status make_move would return.
+    int check_move(Position start, Position end);
     
     // Perform a move from the start Position to the end Position
     // The method returns an integer with the status
     // >= 0 is SUCCESS, < 0 is failure
     int make_move(Position start, Position end) override;
 
+    // Play a move from legal_moves without checking it again, keeping
+    // captured pieces alive so that undo_move can restore them. Advances
+    // the turn. Used by the engine to walk the game tree.
+    void do_move(Move m, MoveRecord& record);
+
+    // Take back a move played by do_move
+    void undo_move(const MoveRecord& record);
+
+    // Populate moves with every legal move of the player to move
+    void legal_moves(MoveList& moves);
+
+    // Compute checkers, check evasion squares and pins for the player to move
+    void compute_masks(LegalMasks& masks) const;
+
+    // Return true if the move from one 1D index to another, already known to
+    // have a valid shape, keeps the mover's king safe
+    bool legal_target(int from, int to, const LegalMasks& masks) const;
+
     // Detects if the passed in player is checking
     // Return true if the player is checking the opponent, false otherwise
     bool check(Player p);
+
+    // Return true if a piece of player p attacks the square with 1D index sq
+    bool square_attacked(int sq, Player p) const;
     
+    // Return how many times the current position occurred before, counting
+    // only positions since the last capture or pawn move
+    int repetitions() const;
+
+    // Return a key of what the outcome of the next move depends on: the
+    // position, the halfmove clock and the repetition count. Precompute
+    // keys its replies on it, so a position reached again is worked out again.
+    uint64_t reply_key() const;
+
+    // Return true if 50 moves by each player went by without a capture or pawn move
+    bool fifty_moves() const { return _halfmove >= FIFTY_MOVE_PLIES; }
+
+    // Return true if neither player can checkmate any more, whatever is
+    // played. Decided from the material signature alone, so it is cheap
+    // enough for every node of a search.
+    virtual bool insufficient_material() const { return Material::insufficient(_material); }
+
     // Reports whether a mate (checkmate or stalemate) is detected
     // Meaning that the player cannot make any legal move
     int mate();
     
+    // Reports how the game has ended without printing anything:
+    // CHECKMATE, STALEMATE, DRAW, GAME_WIN, or 0 while it goes on
+    virtual int outcome();
+
     // Reports whether the chess game is over
     virtual bool game_over() override;
 
+    // Print how the game ended for an outcome() result. Returns true if
+    // the game is over.
+    virtual bool report_outcome(int result);
+
 protected:
 
+    // Ring of position hashes, one pushed before every move played
+    uint64_t _history[HISTORY_SIZE];
+
+    // Number of positions ever pushed to _history
+    int _history_count = 0;
+
+    // Plies since the last capture or pawn move (the halfmove clock)
+    int _halfmove = 0;
+
+    // Journal receiving every move made with make_move, nullptr if none
+    Journal* _journal = nullptr;
+
+    // Plays one side in run, nullptr if both are played by people
+    EnginePlayer* _engine = nullptr;
+
+    // Spectators of the game, nullptr if none
+    SpectatorChannel* _spectators = nullptr;
+
+    // Analyses hints are looked up in, nullptr if none
+    AnalysisCache* _cache = nullptr;
+
+    // Latency cap of hints in ms, 0 for the default
+    int _hint_latency = 0;
+
+    // Replies worked out while run waits for input, nullptr outside run
+    Precompute* _precompute = nullptr;
+
+    // Every move made with make_move in run, nullptr outside run
+    Timeline* _timeline = nullptr;
+
+    // Called by save_game once a snapshot is written, so the journal
+    // starts over on top of it
+    void snapshot_saved(const std::string& filename) {
+        if (_journal != nullptr)
+            _journal->restart(filename);
+    }
+
     // Create all needed factories for the kinds of pieces
     // used in chess (doesn't make the actual pieces)
     virtual void initialize_factories();
 
+    // Hand a move made with make_move or play_checked_turn to the journal and timeline
+    void record_played(Move m);
+
+    // Shared by make_move and do_move: validate and play a move, filling
+    // record, without freeing anything or advancing the turn
+    int apply_move(Position start, Position end, MoveRecord& record);
+
+    // Pack the move between two 1D indices, with its capture and promotion flags
+    Move encode_move(int from, int to) const;
+
+    // Carry out a legal move, filling record
+    void play_move(Move m, MoveRecord& record);
+
+    // Mask of every square attacked by player p. The piece on ignore does
+    // not block sliding pieces, so squares behind a king count as attacked.
+    uint64_t attacks(Player p, int ignore) const;
+
+    // Mask of the squares the piece on from can move to, ignoring king safety
+    uint64_t move_targets(int from) const;
+
+    // Squares a sliding piece on from reaches in direction (dx, dy), up to and
+    // including the first piece that is not on ignore
+    uint64_t slide(int from, int dx, int dy, int ignore) const;
+
+    // Return the 1D index of the first occupied square in mask, -1 if none.
+    // Used on rays from slide(), which hold at most one piece.
+    int occupant(uint64_t mask) const;
+
 };
 
 #endif // CHESS_GAME_H
@@ -0,0 +1,91 @@
+#include <chrono>
+#include <algorithm>
+#include "Clock.h"
+
+void GameClock::set(long base, long increment){
+  _enabled = true;
+  _remaining[WHITE] = _remaining[BLACK] = base;
+  _increment = increment;
+  _running = NO_ONE;
+}
+
+void GameClock::start(Player p){
+  if(!_enabled || _running == p)
+    return;
+  stop();
+  _running = p;
+  _since = now();
+}
+
+bool GameClock::stop(){
+  if(_running == NO_ONE)
+    return true;
+  Player p = _running;
+  _remaining[p] -= now() - _since;
+  _running = NO_ONE;
+  if(_remaining[p] <= 0)
+    return false;
+  _remaining[p] += _increment;
+  return true;
+}
+
+void GameClock::restart(Player p){
+  if(!_enabled)
+    return;
+  if(_running != NO_ONE)
+    _remaining[_running] -= now() - _since;
+  _running = p;
+  _since = now();
+}
+
+long GameClock::remaining(Player p) const{
+  if(p == _running)
+    return _remaining[p] - (now() - _since);
+  return _remaining[p];
+}
+
+int64_t GameClock::now(){
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+// The target is a share of what is left plus most of the increment. The
+// hard limit allows three times that, but never more than a quarter of
+// what is left, so one long think can't lose the game on time.
+TimeManager::TimeManager(long remaining, long increment, bool pondering) :
+  _pondering(pondering), _start(GameClock::now()), _stable(0), _iterations(0) {
+  long usable = std::max(0L, remaining - OVERHEAD);
+  _target = std::min(usable, usable / MOVES_TO_GO + increment * 3 / 4);
+  _hard = std::min(usable / 4 + increment / 2, _target * 3);
+  _hard = std::max(std::min(_hard, usable), _target);
+}
+
+TimeManager::TimeManager(long limit) :
+  _target(limit), _hard(limit), _pondering(false), _start(GameClock::now()), _stable(0), _iterations(0) {}
+
+long TimeManager::elapsed() const{
+  if(_pondering.load(std::memory_order_relaxed))
+    return 0;
+  return GameClock::now() - _start;
+}
+
+bool TimeManager::out_of_time() const{
+  return !_pondering.load(std::memory_order_relaxed) && elapsed() >= _hard;
+}
+
+// The next iteration usually takes longer than all before it together, so
+// it is only started with less than half the stretched target used
+bool TimeManager::next_iteration(Move best){
+  _iterations++;
+  _stable = (_iterations > 1 && best == _best) ? _stable + 1 : 0;
+  _best = best;
+  if(_pondering.load(std::memory_order_relaxed))
+    return true;
+  double scale = _stable == 0 ? 1.5 : (_stable < 3 ? 1.0 : 0.6);
+  return elapsed() < _target * scale / 2 && elapsed() < _hard;
+}
+
+void TimeManager::ponder_hit(){
+  _pondering.store(false, std::memory_order_relaxed);
+}
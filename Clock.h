@@ -0,0 +1,116 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <atomic>
+#include <cstdint>
+#include "Enumerations.h"
+#include "Move.h"
+
+// A chess clock: each player has a time budget that runs down while it is
+// their turn and gains the increment after each of their moves. Times are
+// in milliseconds. A clock that was never set is switched off.
+class GameClock {
+
+public:
+
+    GameClock() : _enabled(false), _increment(0), _running(NO_ONE), _since(0) {
+        _remaining[WHITE] = _remaining[BLACK] = 0;
+    }
+
+    // Give both players base ms, and increment ms after every move
+    void set(long base, long increment);
+
+    bool enabled() const { return _enabled; }
+
+    long increment() const { return _increment; }
+
+    // Start the player's clock, unless it is already running
+    void start(Player p);
+
+    // Stop the running clock, charging its player the time used and
+    // adding the increment. Returns false if the player ran out of time.
+    bool stop();
+
+    // Stop the running clock without the increment, charging its player
+    // the time used, and start p's. After a takeback no move earned one.
+    void restart(Player p);
+
+    // Time the player has left, the running period included
+    long remaining(Player p) const;
+
+    // Return true if the player has run out of time
+    bool flagged(Player p) const { return _enabled && remaining(p) <= 0; }
+
+    // Milliseconds of a steady clock, for timing searches
+    static int64_t now();
+
+private:
+
+    bool _enabled;
+    long _remaining[2];
+    long _increment;
+    Player _running; // NO_ONE when stopped
+    int64_t _since;  // when the running clock was started
+
+};
+
+
+// Sizes a search from the time left on the clock. A search is planned to
+// take a share of the remaining time plus most of the increment (the
+// target), and may never go past a hard limit. Between iterations of
+// iterative deepening the target is stretched while the best move keeps
+// changing and shrunk once it has been stable for a few iterations, since
+// more depth seldom changes a settled choice.
+//
+// While pondering, the time is not the engine's, so the search is never
+// stopped. After ponder_hit the budget counts from when pondering began:
+// what was searched on the right guess is time the engine's clock is
+// spared, and a long enough ponder is answered at once. The search thread
+// reads the manager while another thread may call ponder_hit.
+class TimeManager {
+
+public:
+
+    // Moves a game is assumed to still last when planning a move
+    static const int MOVES_TO_GO = 30;
+
+    // Kept back from every budget for the time it takes to play the move
+    static const long OVERHEAD = 20;
+
+    // Plan a search with remaining ms on the clock and increment ms after
+    // the move. The budget starts now.
+    TimeManager(long remaining, long increment, bool pondering = false);
+
+    // Plan a search of at most limit ms, starting now
+    explicit TimeManager(long limit);
+
+    long target() const { return _target; }
+    long hard_limit() const { return _hard; }
+
+    // Milliseconds since the budget started, 0 while pondering
+    long elapsed() const;
+
+    // Return true once the hard limit has passed
+    bool out_of_time() const;
+
+    // Called after every finished iteration with its best move. Returns
+    // true if another iteration is worth starting.
+    bool next_iteration(Move best);
+
+    // The expected move was played: the search is now timed
+    void ponder_hit();
+
+private:
+
+    long _target;
+    long _hard;
+    std::atomic<bool> _pondering;
+    int64_t _start;
+
+    Move _best;        // best move of the last iteration
+    int _stable;       // iterations in a row it stayed the best
+    int _iterations;
+
+};
+
+#endif // CLOCK_H
@@ -0,0 +1,99 @@
+#include <thread>
+#include <memory>
+#include "ChessGame.h"
+#include "SpookyChess.h"
+#include "Search.h"
+#include "Engine.h"
+
+// In Spooky Chess the ghost lands somewhere new after every move, so a
+// guessed position almost never comes up and pondering is left out
+EnginePlayer::EnginePlayer(const ChessGame& game, Player side, bool pondering, int depth) :
+  _side(side), _pondering(pondering && dynamic_cast<const SpookyChess*>(&game) == nullptr),
+  _depth(depth), _worker(game.clone()), _cache(nullptr), _ponder_key(0), _stop(false), _guess_key(0), _hits(0), _pondered(0) {}
+
+EnginePlayer::~EnginePlayer(){
+  stop();
+  delete _worker;
+}
+
+void EnginePlayer::stop(){
+  _stop = true;
+  if(_thread.joinable())
+    _thread.join();
+}
+
+Move EnginePlayer::choose(ChessGame& game){
+  const GameClock& clock = game.clock();
+  if(_thread.joinable()){
+    bool hit;
+    {
+      std::lock_guard<std::mutex> guard(_lock);
+      hit = _guess_key != 0 && _guess_key == game.position_hash();
+    }
+    if(hit){ //let the search run on, from now under the engine's own budget
+      _hits++;
+      if(_time)
+	_time->ponder_hit();
+      _thread.join();
+      MoveList moves;
+      game.legal_moves(moves);
+      std::lock_guard<std::mutex> guard(_lock);
+      if(_result.found && moves.contains(_result.best))
+	return _result.best;
+    }
+    stop();
+  }
+
+  std::unique_ptr<Search> search(Search::for_game(game));
+  SearchLimits limits(clock.enabled() ? MAX_PLY - 1 : _depth);
+  limits.cache = game.cache();
+  std::unique_ptr<TimeManager> time;
+  if(clock.enabled()){
+    time.reset(new TimeManager(clock.remaining(_side), clock.increment()));
+    limits.time = time.get();
+  }
+  return search->run(limits).best;
+}
+
+// run asks again after every command that is not a move, such as board or
+// hint, which must not throw the pondering away and start its clock over
+void EnginePlayer::ponder(const ChessGame& game){
+  if(!_pondering || (_thread.joinable() && _ponder_key == game.position_hash()))
+    return;
+  stop();
+  game.export_state(_state);
+  _ponder_key = game.position_hash();
+  _cache = game.cache();
+  _stop = false;
+  _guess_key = 0;
+  _result = SearchResult();
+  const GameClock& clock = game.clock();
+  _time.reset(clock.enabled() ? new TimeManager(clock.remaining(_side), clock.increment(), true) : nullptr);
+  _pondered++;
+  _thread = std::thread(&EnginePlayer::work, this);
+}
+
+// Guess the reply, then search the answer to it
+void EnginePlayer::work(){
+  _worker->import_state(_state);
+  std::unique_ptr<Search> search(Search::for_game(*_worker));
+  SearchLimits guess(GUESS_DEPTH);
+  guess.cache = _cache;
+  guess.stop = &_stop;
+  SearchResult reply = search->run(guess);
+  if(!reply.found || _stop)
+    return;
+  MoveRecord record;
+  _worker->do_move(reply.best, record);
+  {
+    std::lock_guard<std::mutex> guard(_lock);
+    _guess_key = _worker->position_hash();
+  }
+  SearchLimits limits(_time ? MAX_PLY - 1 : _depth);
+  limits.cache = _cache;
+  limits.time = _time.get();
+  limits.stop = &_stop;
+  SearchResult answer = search->run(limits);
+  std::lock_guard<std::mutex> guard(_lock);
+  _result = answer;
+}
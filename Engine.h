@@ -0,0 +1,86 @@
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <cstdint>
+#include "Enumerations.h"
+#include "Move.h"
+#include "BoardState.h"
+#include "Search.h"
+
+class ChessGame;
+
+// The engine as a player in ChessGame::run. On a clock, each search is
+// sized by a TimeManager; without one it searches to a fixed depth.
+//
+// While the other player thinks, the engine ponders on a thread of its
+// own: it guesses the reply with a short search, plays it on a copy of the
+// game and searches its answer to that with no time limit. If the guess
+// is played (a ponder hit), the search goes on under a time budget that
+// counts the pondering, so the engine's own clock only pays for what the
+// ponder didn't get to; otherwise it is stopped and the engine searches
+// the actual position. Every search goes through the game's analysis
+// cache, if it has one.
+class EnginePlayer {
+
+public:
+
+    // Depth searched with no clock, and by the guess of the reply
+    static const int DEFAULT_DEPTH = 4;
+    static const int GUESS_DEPTH = 3;
+
+    // Play side in a game of the variant of game, which must not be deleted
+    // first. Ponders unless pondering is false.
+    EnginePlayer(const ChessGame& game, Player side, bool pondering = true, int depth = DEFAULT_DEPTH);
+
+    // Stops pondering
+    ~EnginePlayer();
+
+    EnginePlayer(const EnginePlayer&) = delete;
+    EnginePlayer& operator=(const EnginePlayer&) = delete;
+
+    Player side() const { return _side; }
+
+    // Choose the engine's move in game, with the engine to move
+    Move choose(ChessGame& game);
+
+    // Start pondering on game, with the other player to move, unless this
+    // position is already being pondered on
+    void ponder(const ChessGame& game);
+
+    // Ponder hits so far, and positions pondered on
+    int hits() const { return _hits; }
+    int pondered() const { return _pondered; }
+
+private:
+
+    Player _side;
+    bool _pondering;
+    int _depth;
+
+    ChessGame* _worker;    // the copy pondering plays on
+    AnalysisCache* _cache; // the game's analysis cache, nullptr for none
+    std::thread _thread;
+    BoardState _state;     // position handed to the thread
+    uint64_t _ponder_key;  // position_hash() of that position
+    std::atomic<bool> _stop;
+    std::unique_ptr<TimeManager> _time;
+
+    std::mutex _lock;      // guards the two below
+    uint64_t _guess_key;   // position_hash() after the guessed reply, 0 until known
+    SearchResult _result;  // the thread's answer to the guess
+
+    int _hits, _pondered;
+
+    // Runs on the thread
+    void work();
+
+    // Stop the thread and wait for it
+    void stop();
+
+};
+
+#endif // ENGINE_H
@@ -0,0 +1,28 @@
+// Evaluation weights in centipawns, used by Evaluation and HillSearch.
+// Generated by tune; regenerate with it rather than editing by hand.
+#ifndef EVAL_WEIGHTS_H
+#define EVAL_WEIGHTS_H
+
+// Material values indexed by PieceEnum. The king is never traded and the
+// ghost belongs to no one, so neither counts towards material.
+static const int PIECE_VALUES[] = {100, 500, 320, 330, 900, 0, 0};
+
+// Placement: per rank advanced and per half square away from the middle
+static const int PAWN_ADVANCE = 6;
+static const int PAWN_CENTER = 1;
+static const int MINOR_BASE = 10;
+static const int MINOR_CENTER = 3;
+static const int QUEEN_BASE = 4;
+static const int QUEEN_CENTER = 1;
+static const int KING_ADVANCE = 2;
+
+// Pawn structure
+static const int DOUBLED_PAWN = 12;
+static const int ISOLATED_PAWN = 10;
+static const int PASSED_PAWN[] = {0, 5, 10, 20, 35, 60, 100};
+static const int FREE_PASSED_PAWN = 4;
+
+// King of the Hill: bonus for a king this many steps from the hill
+static const int HILL_BONUS[] = {0, 60, 25, 10};
+
+#endif // EVAL_WEIGHTS_H
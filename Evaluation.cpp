@@ -0,0 +1,290 @@
+#include <cstdlib>
+#include <cstring>
+#include "Game.h"
+#include "Piece.h"
+#include "Evaluation.h"
+#include "EvalWeights.h"
+
+int Evaluation::piece_value(int piece_type){
+  if(piece_type < PAWN_ENUM || piece_type > GHOST_ENUM)
+    return 0;
+  return PIECE_VALUES[piece_type];
+}
+
+// Small positional bonus for a piece standing on (x, y), seen from its owner's side
+static int placement_bonus(const Piece* p, int x, int y, int width, int height){
+  //distance from the middle of the board, in half squares
+  int center = abs(2 * x - (width - 1)) + abs(2 * y - (height - 1));
+  int rank = (p->owner() == WHITE) ? y : height - 1 - y; //how far the piece has advanced
+  switch(p->piece_type()){
+  case PAWN_ENUM:
+    return PAWN_ADVANCE * rank - PAWN_CENTER * center;
+  case KNIGHT_ENUM:
+  case BISHOP_ENUM:
+    return MINOR_BASE - MINOR_CENTER * center;
+  case QUEEN_ENUM:
+    return QUEEN_BASE - QUEEN_CENTER * center;
+  case KING_ENUM:
+    return -KING_ADVANCE * rank; //stay behind the pawns
+  }
+  return 0;
+}
+
+// Pawn structure terms (EvalWeights.h): DOUBLED_PAWN for each extra pawn a
+// player has on a file, ISOLATED_PAWN for a pawn with no pawns of its own on
+// the files beside it, PASSED_PAWN by ranks advanced, and FREE_PASSED_PAWN
+// per rank advanced for a passed pawn whose next square is empty
+
+// How often each pawn structure term applies to each player
+struct PawnCounts {
+    int doubled[2];
+    int isolated[2];
+    int passed[2][7];   // passed pawns by ranks advanced, 6 or more counted as 6
+    uint64_t mask[2];   // 1D squares of the passed pawns
+};
+
+PawnTable::PawnTable(int bits) : _entries((size_t)1 << bits), _mask(((uint64_t)1 << bits) - 1), _hits(0), _misses(0) {
+  for(size_t i = 0; i < _entries.size(); i++)
+    _entries[i].valid = false;
+}
+
+const PawnEntry& PawnTable::probe(const Game& game){
+  uint64_t key = game.pawn_hash();
+  PawnEntry& entry = _entries[key & _mask];
+  if(entry.valid && entry.key == key){
+    _hits++;
+    return entry;
+  }
+  _misses++;
+  Evaluation::pawn_structure(game, entry); //replace whatever was there
+  return entry;
+}
+
+// A pawn is passed when no enemy pawn stands ahead of it on its own file or
+// the files beside it, isolated when its owner has no pawn on the files beside it
+static void count_pawns(const Game& game, PawnCounts& counts){
+  memset(&counts, 0, sizeof counts);
+  int width = game.width(), height = game.height();
+  if(width * height > 64) //squares must fit in the masks
+    return;
+
+  //per player and file: number of pawns, and the lowest and highest row holding one
+  int count[2][64] = {{0}}, low[2][64], high[2][64];
+  for(int y = 0; y < height; y++){
+    for(int x = 0; x < width; x++){
+      const Piece* p = game.get_piece(Position(x, y));
+      if(p == nullptr || p->piece_type() != PAWN_ENUM || p->owner() == NO_ONE)
+	continue;
+      Player o = p->owner();
+      if(count[o][x]++ == 0)
+	low[o][x] = y;
+      high[o][x] = y;
+    }
+  }
+
+  for(int x = 0; x < width; x++){
+    for(int o = WHITE; o <= BLACK; o++){
+      if(count[o][x] > 1)
+	counts.doubled[o] += count[o][x] - 1;
+    }
+  }
+
+  for(int y = 0; y < height; y++){
+    for(int x = 0; x < width; x++){
+      const Piece* p = game.get_piece(Position(x, y));
+      if(p == nullptr || p->piece_type() != PAWN_ENUM || p->owner() == NO_ONE)
+	continue;
+      Player o = p->owner();
+      Player enemy = (o == WHITE) ? BLACK : WHITE;
+      bool isolated = true, passed = true;
+      for(int f = x - 1; f <= x + 1; f++){
+	if(f < 0 || f >= width)
+	  continue;
+	if(f != x && count[o][f] > 0)
+	  isolated = false;
+	if(count[enemy][f] > 0 && (o == WHITE ? high[enemy][f] > y : low[enemy][f] < y))
+	  passed = false;
+      }
+      if(isolated)
+	counts.isolated[o]++;
+      if(passed){
+	int rank = (o == WHITE) ? y : height - 1 - y;
+	counts.passed[o][rank < 6 ? rank : 6]++;
+	counts.mask[o] |= (uint64_t)1 << (y * width + x);
+      }
+    }
+  }
+}
+
+void Evaluation::pawn_structure(const Game& game, PawnEntry& entry){
+  PawnCounts counts;
+  count_pawns(game, counts);
+  entry.key = game.pawn_hash();
+  entry.valid = true;
+  entry.score = 0;
+  for(int o = WHITE; o <= BLACK; o++){
+    int score = -DOUBLED_PAWN * counts.doubled[o] - ISOLATED_PAWN * counts.isolated[o];
+    for(int rank = 0; rank <= 6; rank++)
+      score += PASSED_PAWN[rank] * counts.passed[o][rank];
+    entry.score += (o == WHITE) ? score : -score;
+    entry.passed[o] = counts.mask[o];
+  }
+}
+
+// Sum of the ranks advanced by the passed pawns in mask whose next square
+// is empty. This depends on the other pieces, so it is not part of the
+// cached entry.
+static int free_passed_ranks(const Game& game, uint64_t mask, Player owner){
+  int ranks = 0;
+  int width = game.width(), height = game.height();
+  for(uint64_t rest = mask; rest != 0; rest &= rest - 1){
+    int square = __builtin_ctzll(rest);
+    int x = square % width, y = square / width;
+    int next = (owner == WHITE) ? y + 1 : y - 1;
+    if(next < 0 || next >= height)
+      continue;
+    if(game.get_piece(Position(x, next)) == nullptr)
+      ranks += (owner == WHITE) ? y : height - 1 - y;
+  }
+  return ranks;
+}
+
+// Sum material, placement and pawn structure for both sides
+int Evaluation::evaluate(const Game& game, PawnTable* pawns){
+  int score = 0; //from white's point of view
+  for(unsigned int y = 0; y < game.height(); y++){
+    for(unsigned int x = 0; x < game.width(); x++){
+      Piece* p = game.get_piece(Position(x, y));
+      if(p == nullptr || p->owner() == NO_ONE)
+	continue;
+      int value = piece_value(p->piece_type()) + placement_bonus(p, x, y, game.width(), game.height());
+      score += (p->owner() == WHITE) ? value : -value;
+    }
+  }
+  PawnEntry local;
+  const PawnEntry* entry = &local;
+  if(pawns != nullptr)
+    entry = &pawns->probe(game);
+  else
+    pawn_structure(game, local);
+  score += entry->score;
+  score += FREE_PASSED_PAWN * free_passed_ranks(game, entry->passed[WHITE], WHITE);
+  score -= FREE_PASSED_PAWN * free_passed_ranks(game, entry->passed[BLACK], BLACK);
+  return game.player_turn() == WHITE ? score : -score;
+}
+
+// A king and a rook or queen beat a bare king by driving it to the edge
+// with the other king close by, far beyond what a search sees from the
+// middle of the board. So the score leads there: the lone king's distance
+// from the middle, in half squares as placement_bonus measures it, and the
+// closeness of the kings, on top of a margin no ordinary position reaches.
+static const int KNOWN_WIN = 2000;
+
+struct EndgameRule {
+  uint64_t signature;
+  int piece;       // the strong side's piece besides its king
+  Player strong;
+};
+
+static const EndgameRule ENDGAMES[] = {
+  {Material::bare_kings() + Material::unit(ROOK_ENUM, WHITE), ROOK_ENUM, WHITE},
+  {Material::bare_kings() + Material::unit(ROOK_ENUM, BLACK), ROOK_ENUM, BLACK},
+  {Material::bare_kings() + Material::unit(QUEEN_ENUM, WHITE), QUEEN_ENUM, WHITE},
+  {Material::bare_kings() + Material::unit(QUEEN_ENUM, BLACK), QUEEN_ENUM, BLACK}
+};
+
+static int mating_score(const Game& game, int piece, Player strong){
+  Player weak = strong == WHITE ? BLACK : WHITE;
+  int width = game.width(), height = game.height();
+  int lone = game.king_square(weak), other = game.king_square(strong);
+  int x = lone % width, y = lone / width;
+  int edge = abs(2 * x - (width - 1)) + abs(2 * y - (height - 1));
+  int dx = abs(x - other % width), dy = abs(y - other / width);
+  int kings = dx > dy ? dx : dy;
+  return KNOWN_WIN + PIECE_VALUES[piece] + 10 * edge + 20 * ((width > height ? width : height) - kings);
+}
+
+bool Evaluation::endgame(const Game& game, int& score){
+  uint64_t signature = game.material();
+  for(size_t i = 0; i < sizeof(ENDGAMES) / sizeof(ENDGAMES[0]); i++){
+    if(signature != ENDGAMES[i].signature)
+      continue;
+    if(game.king_square(WHITE) < 0 || game.king_square(BLACK) < 0)
+      return false;
+    int value = mating_score(game, ENDGAMES[i].piece, ENDGAMES[i].strong);
+    score = game.player_turn() == ENDGAMES[i].strong ? value : -value;
+    return true;
+  }
+  return false;
+}
+
+void Evaluation::weights(int* terms){
+  for(int type = PAWN_ENUM; type <= QUEEN_ENUM; type++)
+    terms[TERM_MATERIAL + type] = PIECE_VALUES[type];
+  terms[TERM_PAWN_ADVANCE] = PAWN_ADVANCE;
+  terms[TERM_PAWN_CENTER] = PAWN_CENTER;
+  terms[TERM_MINOR_BASE] = MINOR_BASE;
+  terms[TERM_MINOR_CENTER] = MINOR_CENTER;
+  terms[TERM_QUEEN_BASE] = QUEEN_BASE;
+  terms[TERM_QUEEN_CENTER] = QUEEN_CENTER;
+  terms[TERM_KING_ADVANCE] = KING_ADVANCE;
+  terms[TERM_DOUBLED_PAWN] = DOUBLED_PAWN;
+  terms[TERM_ISOLATED_PAWN] = ISOLATED_PAWN;
+  for(int rank = 1; rank <= 6; rank++)
+    terms[TERM_PASSED_PAWN + rank - 1] = PASSED_PAWN[rank];
+  terms[TERM_FREE_PASSED_PAWN] = FREE_PASSED_PAWN;
+  for(int distance = 1; distance <= 3; distance++)
+    terms[TERM_HILL_BONUS + distance - 1] = HILL_BONUS[distance];
+}
+
+// Mirrors placement_bonus, count_pawns and evaluate term by term, so that
+// the weights times these coefficients give back evaluate()
+void Evaluation::features(const Game& game, int* terms){
+  for(int i = 0; i < EVAL_TERMS; i++)
+    terms[i] = 0;
+  int width = game.width(), height = game.height();
+  for(int y = 0; y < height; y++){
+    for(int x = 0; x < width; x++){
+      const Piece* p = game.get_piece(Position(x, y));
+      if(p == nullptr || p->owner() == NO_ONE)
+	continue;
+      int sign = (p->owner() == WHITE) ? 1 : -1;
+      int center = abs(2 * x - (width - 1)) + abs(2 * y - (height - 1));
+      int rank = (p->owner() == WHITE) ? y : height - 1 - y;
+      switch(p->piece_type()){
+      case PAWN_ENUM:
+	terms[TERM_PAWN_ADVANCE] += sign * rank;
+	terms[TERM_PAWN_CENTER] -= sign * center;
+	break;
+      case KNIGHT_ENUM:
+      case BISHOP_ENUM:
+	terms[TERM_MINOR_BASE] += sign;
+	terms[TERM_MINOR_CENTER] -= sign * center;
+	break;
+      case QUEEN_ENUM:
+	terms[TERM_QUEEN_BASE] += sign;
+	terms[TERM_QUEEN_CENTER] -= sign * center;
+	break;
+      case KING_ENUM:
+	terms[TERM_KING_ADVANCE] -= sign * rank;
+	break;
+      }
+      if(p->piece_type() <= QUEEN_ENUM)
+	terms[TERM_MATERIAL + p->piece_type()] += sign;
+    }
+  }
+  PawnCounts counts;
+  count_pawns(game, counts);
+  for(int o = WHITE; o <= BLACK; o++){
+    int sign = (o == WHITE) ? 1 : -1;
+    terms[TERM_DOUBLED_PAWN] -= sign * counts.doubled[o];
+    terms[TERM_ISOLATED_PAWN] -= sign * counts.isolated[o];
+    for(int rank = 1; rank <= 6; rank++)
+      terms[TERM_PASSED_PAWN + rank - 1] += sign * counts.passed[o][rank];
+    terms[TERM_FREE_PASSED_PAWN] += sign * free_passed_ranks(game, counts.mask[o], (Player)o);
+  }
+  if(game.player_turn() == BLACK){
+    for(int i = 0; i < EVAL_TERMS; i++)
+      terms[i] = -terms[i];
+  }
+}
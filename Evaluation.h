@@ -0,0 +1,90 @@
+#ifndef EVALUATION_H
+#define EVALUATION_H
+
+#include <vector>
+#include <cstdint>
+#include "Game.h"
+
+// Pawn structure of one position, as cached in a PawnTable
+struct PawnEntry {
+    uint64_t key;       // pawn hash of the position
+    bool valid;         // false until the entry is first filled
+    int score;          // doubled, isolated and passed pawn terms, from white's point of view
+    uint64_t passed[2]; // 1D squares of each player's passed pawns
+};
+
+// Hash table of pawn structures keyed by Game::pawn_hash. Pawns move far
+// less often than other pieces, so most positions a search visits find
+// their structure here. A table is not thread safe; give each search its own.
+class PawnTable {
+
+public:
+
+    // A table of 2^bits entries
+    explicit PawnTable(int bits = 12);
+
+    // Return the pawn structure of the game's position, working it out on a miss
+    const PawnEntry& probe(const Game& game);
+
+    long hits() const { return _hits; }
+    long misses() const { return _misses; }
+
+private:
+
+    std::vector<PawnEntry> _entries;
+    uint64_t _mask;
+    long _hits, _misses;
+
+};
+
+// Tunable evaluation weights (EvalWeights.h), in the order Evaluation::features
+// reports how often each applies
+enum EvalTerm {
+    TERM_MATERIAL = 0,       // five entries: pawn, rook, knight, bishop, queen
+    TERM_PAWN_ADVANCE = 5,
+    TERM_PAWN_CENTER,
+    TERM_MINOR_BASE,
+    TERM_MINOR_CENTER,
+    TERM_QUEEN_BASE,
+    TERM_QUEEN_CENTER,
+    TERM_KING_ADVANCE,
+    TERM_DOUBLED_PAWN,
+    TERM_ISOLATED_PAWN,
+    TERM_PASSED_PAWN,        // six entries: ranks advanced 1 to 6
+    TERM_FREE_PASSED_PAWN = TERM_PASSED_PAWN + 6,
+    TERM_HILL_BONUS,         // three entries: king 1 to 3 steps from the hill
+    EVAL_TERMS = TERM_HILL_BONUS + 3
+};
+
+// Static evaluation used by the engine to score positions
+class Evaluation {
+
+public:
+
+    // Return the material value of a piece type in centipawns
+    static int piece_value(int piece_type);
+
+    // Score the position in centipawns from the point of view
+    // of the player whose turn it is. Positive is good for them.
+    // The pawn structure comes from pawns if given, else it is worked out.
+    static int evaluate(const Game& game, PawnTable* pawns = nullptr);
+
+    // Score an endgame that has a rule of its own, recognised by its
+    // material signature, from the point of view of the player to move.
+    // Returns false, leaving score alone, for every other position.
+    static bool endgame(const Game& game, int& score);
+
+    // Work out the pawn structure of the game's position into entry
+    static void pawn_structure(const Game& game, PawnEntry& entry);
+
+    // Fill terms (EVAL_TERMS entries) with the weights compiled in
+    static void weights(int* terms);
+
+    // Fill terms (EVAL_TERMS entries) with how often each weight counts in
+    // evaluate() for the player to move, so that the sum of weight times
+    // count is the score. The hill terms are left at 0; HillSearch adds them.
+    static void features(const Game& game, int* terms);
+
+};
+
+#endif // EVALUATION_H
@@ -6,7 +6,6 @@
 #include <vector>
 
 #include "Game.h"
-#include "Prompts.h"
 #include "Piece.h"
 
 using std::vector;
@@ -23,30 +22,48 @@ Game::~Game() {
     for (size_t i = 0; i < _registered_factories.size(); i++) {
       delete _registered_factories[i];
     }
-    //Delete the individual piece pointers
-    for(unsigned int i = 0; i < _pieces.size(); i++){
-      if(_pieces[i] != nullptr)
-	delete _pieces[i];
+    //Delete the pieces, each of which may stand on many squares
+    for (int o = 0; o <= NO_ONE; o++) {
+      for (int t = 0; t <= GHOST_ENUM; t++)
+        delete _piece_set[o][t];
+    }
+}
+
+// Copy the board of another game. The copy gets its own set of pieces,
+// made by the other game's factories since the copy has none yet.
+Game::Game(const Game& other) :
+    _width(other._width), _height(other._height), _pieces(other._pieces.size(), nullptr),
+    _turn(other._turn), _hash(other._hash), _pawn_hash(other._pawn_hash), _material(other._material), _clock(other._clock),
+    _piece_set(), _board_on(other._board_on) {
+    _king_square[WHITE] = other._king_square[WHITE];
+    _king_square[BLACK] = other._king_square[BLACK];
+    for (int o = 0; o <= NO_ONE; o++) {
+      for (int t = 0; t <= GHOST_ENUM; t++) {
+        if (other._piece_set[o][t] != nullptr)
+          _piece_set[o][t] = other.new_piece(t, static_cast<Player>(o));
+      }
+    }
+    for (size_t i = 0; i < other._pieces.size(); i++) {
+        const Piece* p = other._pieces[i];
+        if (p != nullptr)
+            _pieces[i] = _piece_set[p->owner()][p->piece_type()];
     }
 }
 
 // Create a Piece on the board using the appropriate factory.
 // Returns true if the piece was successfully placed on the board.
 bool Game::init_piece(int piece_type, Player owner, Position pos) {
-    Piece* piece = new_piece(piece_type, owner);
+    Piece* piece = shared_piece(piece_type, owner);
     if (!piece) return false;
 
-    // Fail if the position is out of bounds
-    if (!valid_position(pos)) {
-        Prompts::out_of_bounds();
-        return false;
-    }
-    // Fail if the position is occupied
-    if (get_piece(pos)) {
-        Prompts::blocked();
+    // Fail if the position is out of bounds or occupied
+    if (!valid_position(pos) || get_piece(pos))
         return false;
-    }
     _pieces[index(pos)] = piece;
+    toggle_hash(piece, index(pos));
+    add_material(piece);
+    if (piece_type == KING_ENUM && owner != NO_ONE)
+        _king_square[owner] = index(pos);
     return true;
 }
 
@@ -55,10 +72,7 @@ bool Game::init_piece(int piece_type, Player owner, Position pos) {
 Piece* Game::get_piece(Position pos) const {
     if (valid_position(pos))
         return _pieces[index(pos)];
-    else {
-        Prompts::out_of_bounds();
-        return nullptr;
-    }
+    return nullptr;
 }
 
 // Print the appropriate character for each different piece on the screen
@@ -207,13 +221,54 @@ void Game::load_pieces(ifstream& file){
 }
 
 
+// Look up the game's instance of a kind of piece, making it the first time
+Piece* Game::shared_piece(int piece_type, Player owner) {
+    if (piece_type < 0 || piece_type > GHOST_ENUM || owner < WHITE || owner > NO_ONE)
+        return nullptr;
+    Piece*& piece = _piece_set[owner][piece_type];
+    if (piece == nullptr)
+        piece = new_piece(piece_type, owner);
+    return piece;
+}
+
+void Game::export_state(BoardState& state) const {
+    for (int i = 0; i < BoardState::SQUARES; i++) {
+        const Piece* p = (i < (int)_pieces.size()) ? _pieces[i] : nullptr;
+        state.squares[i] = p ? BoardState::code(p->piece_type(), p->owner()) : BoardState::EMPTY;
+    }
+    state.width = _width;
+    state.height = _height;
+    state.turn = _turn;
+    state.king_square[WHITE] = _king_square[WHITE];
+    state.king_square[BLACK] = _king_square[BLACK];
+    state.hash = _hash;
+    state.pawn_hash = _pawn_hash;
+}
+
+bool Game::import_state(const BoardState& state) {
+    if (state.width != _width || state.height != _height || _pieces.size() > (size_t)BoardState::SQUARES)
+        return false;
+    _material = 0; //not in the state, but counted along the way
+    for (size_t i = 0; i < _pieces.size(); i++) {
+        int code = state.squares[i];
+        _pieces[i] = (code == BoardState::EMPTY) ? nullptr
+            : shared_piece(code & 7, static_cast<Player>(code >> 3));
+        add_material(_pieces[i]);
+    }
+    _turn = state.turn;
+    _king_square[WHITE] = state.king_square[WHITE];
+    _king_square[BLACK] = state.king_square[BLACK];
+    _hash = state.hash;
+    _pawn_hash = state.pawn_hash;
+    return true;
+}
+
 // Search the factories to find a factory that can translate
 //`piece_type' into a Piece, and use it to create the Piece.
 // Returns nullptr if factory not found.
-Piece* Game::new_piece(int piece_type, Player owner) {
-    PieceGenMap::iterator it = _registered_factories.find(piece_type);
+Piece* Game::new_piece(int piece_type, Player owner) const {
+    PieceGenMap::const_iterator it = _registered_factories.find(piece_type);
     if (it == _registered_factories.end()) { // not found
-        std::cout << "Piece type " << piece_type << " has no generator\n";
         return nullptr;
     } else {
         return it->second->new_piece(owner);
@@ -236,8 +291,7 @@ bool Game::add_factory(AbstractPieceFactory* piece_gen) {
         _registered_factories[piece_type] = piece_gen;
         return true;
     } else {
-        std::cout << "Piece type " << piece_type << " already has a generator\n";
-        return false;
+        return false; // already has a generator
     }
 }
 
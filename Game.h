@@ -9,6 +9,10 @@
 #include "Enumerations.h"
 #include "Piece.h"
 #include "Terminal.h"
+#include "Zobrist.h"
+#include "Material.h"
+#include "BoardState.h"
+#include "Clock.h"
 
 
 // Game status code enumeration. Note that any value > 0
@@ -30,6 +34,7 @@ enum status {
   GHOST_CAPTURE,
   CHECKMATE,
   STALEMATE,
+  DRAW,
   GAME_WIN,
   GAME_OVER
 };
@@ -47,7 +52,16 @@ class Game {
 public:
     // Construct a board with the specified dimensions
     Game(unsigned int w = 8, unsigned int h = 8, int t = 1) :
-        _width(w), _height(h), _pieces(w * h, nullptr), _turn(t) {}
+        _width(w), _height(h), _pieces(w * h, nullptr), _turn(t), _hash(0), _pawn_hash(0), _material(0), _piece_set() {
+        _king_square[WHITE] = _king_square[BLACK] = -1;
+    }
+
+    // Copy a game, creating the copy's pieces through the other game's factories.
+    // Derived classes register their own factories for the copy.
+    Game(const Game& other);
+
+    // Games own their pieces, so they are copied but never assigned
+    Game& operator=(const Game&) = delete;
 
     // Virtual destructor is necessary for a class with virtual methods
     virtual ~Game();
@@ -66,6 +80,28 @@ public:
     // if the position is valid and occupied, nullptr otherwise.
     Piece* get_piece(Position pos) const;
 
+    // Return the 1D index of the player's king, -1 if it has none
+    int king_square(Player p) const { return _king_square[p]; }
+
+    // Write the position into state. Variants add their own fields.
+    virtual void export_state(BoardState& state) const;
+
+    // Set the position from state, exported by a game of the same variant.
+    // Takes constant time; returns false if the board sizes differ.
+    virtual bool import_state(const BoardState& state);
+
+    // Return the Zobrist hash of the pieces on the board and the side to move
+    uint64_t position_hash() const {
+        return player_turn() == BLACK ? _hash ^ Zobrist::black_to_move() : _hash;
+    }
+
+    // Return the Zobrist hash of the pawns alone, which changes only when a
+    // pawn moves, is captured or promotes
+    uint64_t pawn_hash() const { return _pawn_hash; }
+
+    // Return the material signature of the pieces on the board (Material.h)
+    uint64_t material() const { return _material; }
+
     // Return the player whose turn it is
     Player player_turn() const { 
         return static_cast<Player>(!(_turn % 2)); 
@@ -76,6 +112,10 @@ public:
       return static_cast<Player>(_turn % 2);
     }
 
+    // Return the players' clock, switched off unless set
+    GameClock& clock() { return _clock; }
+    const GameClock& clock() const { return _clock; }
+
     // Return the current turn number (turn sequence number)
     int turn() const {
         return _turn;
@@ -129,12 +169,57 @@ protected:
     // Board dimensions
     unsigned int _width , _height;
 
-    // Vector containing all the Pieces currently on the board
+    // Vector containing all the Pieces currently on the board. Pieces have no
+    // state of their own, so every square holding a white pawn points to
+    // the same white pawn from _piece_set, and moving or capturing a piece
+    // never creates or deletes one.
     std::vector<Piece*> _pieces;
 
     // Current game turn sequence number
     int _turn;
 
+    // 1D index of each player's king, kept up to date as kings move
+    int _king_square[2];
+
+    // Zobrist hash of the pieces only, kept up to date as pieces move
+    uint64_t _hash;
+
+    // Zobrist hash of the pawns only, kept up to date along with _hash
+    uint64_t _pawn_hash;
+
+    // Material signature, kept up to date as pieces are captured and promoted
+    uint64_t _material;
+
+    // Time each player has left, if the game is played on a clock
+    GameClock _clock;
+
+    // The one instance of each kind of piece, indexed by owner and piece
+    // type, created on first use and owned by the game
+    Piece* _piece_set[NO_ONE + 1][GHOST_ENUM + 1];
+
+    // Return the game's instance of a kind of piece, nullptr if no factory makes it
+    Piece* shared_piece(int piece_type, Player owner);
+
+    // Add or remove a piece on the 1D index square from the hashes
+    void toggle_hash(const Piece* piece, int square) {
+        if (piece == nullptr)
+            return;
+        uint64_t key = Zobrist::piece(piece->piece_type(), piece->owner(), square);
+        _hash ^= key;
+        if (piece->piece_type() == PAWN_ENUM)
+            _pawn_hash ^= key;
+    }
+
+    // Count a piece placed on the board in the material signature, or one taken off
+    void add_material(const Piece* piece) {
+        if (piece != nullptr)
+            _material += Material::unit(piece->piece_type(), piece->owner());
+    }
+    void remove_material(const Piece* piece) {
+        if (piece != nullptr)
+            _material -= Material::unit(piece->piece_type(), piece->owner());
+    }
+
     // Whether the board is switched on
     bool _board_on;
 
@@ -160,7 +245,7 @@ protected:
 
 
     // Functionality for creating a new piece (called by init_piece)
-    Piece* new_piece(int piece_type, Player owner);
+    Piece* new_piece(int piece_type, Player owner) const;
 
     // Functionality for adding piece factories (called by constructor)
     bool add_factory(AbstractPieceFactory* f);
@@ -18,10 +18,12 @@ using std::endl;
 
 //Exact same setup as ChessGame
 HillChess::HillChess() : ChessGame(){
+  place_hill();
 }
 
 // Non-default constructor for King of Hill Chess
 HillChess::HillChess(string filename, int type) : ChessGame(filename, type){
+  place_hill();
   ifstream file(filename);
   string game; //used to store game choice
   file >> game;
@@ -53,32 +55,46 @@ void HillChess::save_game(){
   //save the state of pieces
   save_piece_state(file);
   file.close();
+  snapshot_saved(name);
   Prompts::save_success();
 }
 
 // Return whether the game is over, prints out msg about how the game is over:
 // Checkmate, stalemate, or conquered
-bool HillChess::game_over(){
-  //Check for mate first
-  if(mate() == CHECKMATE){
-      Prompts::checkmate(opponent());
-      Prompts::win(opponent(), turn()-1);
-      return true;
-  }else if(mate() == STALEMATE){
-    Prompts::stalemate();
+bool HillChess::report_outcome(int result){
+  if(result == GAME_WIN){
+    Player winner = hill_winner();
+    Prompts::conquered(winner); //prompts conquered msg
+    Prompts::win(winner, turn()-1);
     return true;
   }
-  
-  // Check for conquer on middle squares
-  for(int i = 3; i < 5; i++){
-    for(int j = 3; j < 5; j++){ //loop through the 4 middle squares
-      Piece* king = _pieces[index(Position(i, j))];
-      if(king != nullptr && king->piece_type() == KING_ENUM){ //if there is a king, someone has won
-	Prompts::conquered(king->owner()); //prompts conquered msg
-	Prompts::win(king->owner(), turn()-1); 
-	return true; 
-      }
-    }
-  }
-  return false;
+
+  // Otherwise a mate or a draw
+  return ChessGame::report_outcome(result);
+}
+
+int HillChess::outcome(){
+  if(hill_winner() != NO_ONE)
+    return GAME_WIN;
+  return ChessGame::outcome();
+}
+
+// Number of king moves from the player's king to the closest hill square
+int HillChess::hill_distance(Player p) const{
+  if(_king_square[p] < 0)
+    return _width > _height ? _width : _height;
+  Position king = pos(_king_square[p]);
+  int low_x = hill_low(_width), high_x = hill_high(_width);
+  int low_y = hill_low(_height), high_y = hill_high(_height);
+  int dx = (int)king.x < low_x ? low_x - king.x : ((int)king.x > high_x ? king.x - high_x : 0);
+  int dy = (int)king.y < low_y ? low_y - king.y : ((int)king.y > high_y ? king.y - high_y : 0);
+  return dx > dy ? dx : dy;
+}
+
+// The hill covers the middle files of the middle ranks
+void HillChess::place_hill(){
+  _hill = 0;
+  for(int y = hill_low(_height); y <= hill_high(_height); ++y)
+    for(int x = hill_low(_width); x <= hill_high(_width); ++x)
+      _hill |= 1ULL << index(Position(x, y));
 }
@@ -2,6 +2,7 @@
 #define HILLCHESS_H
 
 #include <string>
+#include <cstdint>
 #include "ChessGame.h"
 
 class HillChess : public ChessGame {
@@ -12,14 +13,51 @@ public:
     // Creates new game from loaded file
     HillChess(std::string filename, int type);
 
-    // Return true if game is over.
-    // Prints out message indicating how the game ended:
-    // Checkmate, stalemate, or conquered hill
-    bool game_over() override;
+    // Print the message for a conquered hill, or as in standard chess
+    bool report_outcome(int result) override;
+
+    // Reports how the game has ended: GAME_WIN when a king is on the hill,
+    // otherwise as in standard chess
+    int outcome() override;
+
+    // Bare kings can still race to the hill, so material never runs out
+    bool insufficient_material() const override { return false; }
 
     //saves current state of game
     void save_game() override;
 
+    // Return a new copy of this game. Caller owns the result.
+    ChessGame* clone() const override { return new HillChess(*this); }
+
+    // Return the bit mask of the hill squares, d4, e4, d5 and e5 on 8x8
+    uint64_t hill_mask() const { return _hill; }
+
+    // Return true if the player's king stands on the hill
+    bool on_hill(Player p) const {
+        return _king_square[p] >= 0 && ((_hill >> _king_square[p]) & 1);
+    }
+
+    // Return the player whose king has reached the hill, NO_ONE if neither
+    Player hill_winner() const {
+        if (on_hill(WHITE)) return WHITE;
+        if (on_hill(BLACK)) return BLACK;
+        return NO_ONE;
+    }
+
+    // Return how many king steps the player's king is away from the hill
+    int hill_distance(Player p) const;
+
+private:
+    // The hill's lowest and highest files and ranks: the middle two of an
+    // even side, the middle one of an odd side
+    int hill_low(unsigned int side) const { return ((int)side - 1) / 2; }
+    int hill_high(unsigned int side) const { return (int)side / 2; }
+
+    // Fill _hill from the board's size
+    void place_hill();
+
+    uint64_t _hill; // bit mask of the hill squares, indexed by 1D board index
+
 };
 
 #endif // HILLCHESS_H
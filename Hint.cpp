@@ -0,0 +1,128 @@
+#include <thread>
+#include <memory>
+#include <chrono>
+#include <algorithm>
+#include "ChessGame.h"
+#include "AnalysisCache.h"
+#include "Search.h"
+#include "Hint.h"
+
+HintSearch::HintSearch(const ChessGame& game, AnalysisCache* cache) :
+  _worker(game.clone()), _cache(cache), _stop(false), _key(0), _latency(0), _pending(false), _finished(false), _quit(false) {}
+
+HintSearch::~HintSearch(){
+  {
+    std::lock_guard<std::mutex> guard(_lock);
+    _quit = true;
+  }
+  _stop = true;
+  _wake.notify_one();
+  if(_thread.joinable())
+    _thread.join();
+  delete _worker;
+}
+
+SearchResult HintSearch::hint(ChessGame& game, int latency){
+  std::chrono::steady_clock::time_point deadline =
+    std::chrono::steady_clock::now() + std::chrono::milliseconds(latency);
+  MoveList moves;
+  game.legal_moves(moves);
+  SearchResult answer;
+  if(moves.empty())
+    return answer;
+  if(moves.size() == 1){ //nothing to think about
+    answer.found = true;
+    answer.best = moves[0];
+    return answer;
+  }
+
+  //hand the position over; a search of an earlier one stops at its next
+  //check. Asked again, the search starts over and only deeper answers count.
+  uint64_t key = game.position_hash();
+  std::unique_lock<std::mutex> guard(_lock);
+  if(_key != key)
+    _best = SearchResult();
+  game.export_state(_state);
+  _key = key;
+  _latency = latency;
+  _pending = true;
+  _finished = false;
+  _stop = true;
+  if(!_thread.joinable())
+    _thread = std::thread(&HintSearch::work, this);
+  _wake.notify_one();
+
+  _improved.wait_until(guard, deadline, [this]{ return _finished; });
+  answer = _best;
+  _pending = false; //no one is waiting for anything deeper
+  _stop = true;
+  guard.unlock();
+
+  if(!answer.found || !moves.contains(answer.best)){ //nothing yet: fall back on the first capture
+    answer = SearchResult();
+    answer.found = true;
+    answer.best = moves[0];
+    for(int i = 0; i < moves.size(); i++){
+      if(moves[i].is(Move::CAPTURE)){
+	answer.best = moves[i];
+	break;
+      }
+    }
+  }
+  return answer;
+}
+
+void HintSearch::publish(uint64_t key, const SearchResult& result){
+  std::lock_guard<std::mutex> guard(_lock);
+  if(key != _key || _pending || (_best.found && result.depth <= _best.depth))
+    return;
+  _best = result;
+}
+
+void HintSearch::finish(uint64_t key){
+  std::lock_guard<std::mutex> guard(_lock);
+  if(key == _key && !_pending){ //nothing deeper to wait for
+    _finished = true;
+    _improved.notify_all();
+  }
+}
+
+// Wait for a position, then deepen on it until stopped
+void HintSearch::work(){
+  std::unique_ptr<Search> search;
+  while(true){
+    uint64_t key;
+    long budget;
+    {
+      std::unique_lock<std::mutex> guard(_lock);
+      _wake.wait(guard, [this]{ return _pending || _quit; });
+      if(_quit)
+	return;
+      _worker->import_state(_state);
+      key = _key;
+      budget = _latency - std::max(2, _latency / 10);
+      _pending = false;
+      _stop = false;
+    }
+    if(!search)
+      search.reset(Search::for_game(*_worker));
+
+    CachedAnalysis cached;
+    if(_cache != nullptr && _cache->probe(search->cache_key(), 1, cached)){
+      SearchResult result;
+      result.found = true;
+      result.best = cached.best;
+      result.score = cached.score;
+      result.depth = cached.depth;
+      publish(key, result);
+    }
+    TimeManager time(budget);
+    SearchLimits limits(MAX_PLY - 1);
+    limits.cache = _cache; //the answer is kept there if it is deeper
+    limits.time = &time;
+    limits.stop = &_stop;
+    limits.progress = [this, key](const SearchResult& result){ publish(key, result); };
+    search->run(limits);
+    finish(key);
+  }
+}
@@ -0,0 +1,76 @@
+#ifndef HINT_H
+#define HINT_H
+
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include "BoardState.h"
+#include "Search.h"
+
+class ChessGame;
+class AnalysisCache;
+
+// Answers the hint command in ChessGame::run within a latency cap. The
+// search runs on a thread of its own, on a copy of the game, and publishes
+// its best move after every finished iteration, so an answer is always at
+// hand: the move ordering's first choice before anything is searched, an
+// analysis from the cache if there is one, then each deeper iteration.
+// The search times itself to end a little before the cap, as the thread
+// hogging the CPU is the one that has to give way for the answer to come
+// back in time, and stops deepening early once an iteration would not
+// finish anyway. Should it overrun, the best answer so far is returned at
+// the cap and the search is told to stop; the caller never waits for it,
+// so a busy machine makes hints shallower, not later.
+class HintSearch {
+
+public:
+
+    // Latency cap in milliseconds when none is given
+    static const int DEFAULT_LATENCY = 50;
+
+    // Search copies of game, which must not be deleted first. Answers are
+    // looked up in and added to cache, if given.
+    explicit HintSearch(const ChessGame& game, AnalysisCache* cache = nullptr);
+
+    // Stops the search and waits for the thread
+    ~HintSearch();
+
+    HintSearch(const HintSearch&) = delete;
+    HintSearch& operator=(const HintSearch&) = delete;
+
+    // Return the best move for the player to move in game found within
+    // latency ms. found is false if there is no legal move.
+    SearchResult hint(ChessGame& game, int latency = DEFAULT_LATENCY);
+
+private:
+
+    ChessGame* _worker;     // the copy the thread searches
+    AnalysisCache* _cache;
+    std::thread _thread;
+    std::atomic<bool> _stop;
+
+    std::mutex _lock;       // guards everything below
+    std::condition_variable _wake;     // a position to search, or quitting
+    std::condition_variable _improved; // the search finished
+    BoardState _state;      // position to search
+    uint64_t _key;          // position_hash() of that position
+    int _latency;           // and the cap it is searched under
+    bool _pending;          // _state not yet picked up
+    bool _finished;         // the search of _key has returned
+    bool _quit;
+    SearchResult _best;     // best answer so far for _key
+
+    // Runs on the thread
+    void work();
+
+    // Keep result for key if it is still wanted and deeper than _best
+    void publish(uint64_t key, const SearchResult& result);
+
+    // The search of key has returned
+    void finish(uint64_t key);
+
+};
+
+#endif // HINT_H
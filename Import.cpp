@@ -0,0 +1,624 @@
+#include <string>
+#include <vector>
+#include <iostream>
+#include <chrono>
+#include <memory>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include "Game.h"
+#include "ChessGame.h"
+#include "Variants.h"
+#include "Import.h"
+
+using std::string;
+using std::vector;
+
+// Records gathered by a chunk before they are handed to the writer
+static const size_t FLUSH_RECORDS = 4096;
+
+// A result that is not known yet
+static const int NO_RESULT = 2;
+
+static bool is_space(char c){
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+// Return the result for white named by a termination token, NO_RESULT if it isn't one
+static int result_token(const char* s, const char* end){
+  size_t n = end - s;
+  if(n == 3 && memcmp(s, "1-0", 3) == 0) return 1;
+  if(n == 3 && memcmp(s, "0-1", 3) == 0) return -1;
+  if(n == 7 && memcmp(s, "1/2-1/2", 7) == 0) return 0;
+  return NO_RESULT;
+}
+
+// Return the PieceEnum named by an upper-case SAN letter, -1 if none
+static int san_piece(char c){
+  switch(c){
+  case 'N': return KNIGHT_ENUM;
+  case 'B': return BISHOP_ENUM;
+  case 'R': return ROOK_ENUM;
+  case 'Q': return QUEEN_ENUM;
+  case 'K': return KING_ENUM;
+  }
+  return -1;
+}
+
+// Read the board, side to move and clocks of a FEN from [s, end) into
+// position. Castling rights and the en passant square don't exist in these
+// rules and are ignored. Returns the end of the FEN, or nullptr if it isn't one.
+static const char* parse_fen(const char* s, const char* end, TrainingPosition& position){
+  const char* letters = "pnbrqk";
+  const int types[] = {PAWN_ENUM, KNIGHT_ENUM, BISHOP_ENUM, ROOK_ENUM, QUEEN_ENUM, KING_ENUM};
+  int kings[2] = {0, 0};
+  int x = 0, y = 7;
+  for(int i = 0; i < BoardState::SQUARES; i++)
+    position.squares[i] = BoardState::EMPTY;
+  for(; s < end && !is_space(*s); s++){
+    char c = *s;
+    if(c == '/'){
+      if(x != 8 || y == 0)
+	return nullptr;
+      x = 0;
+      y--;
+    }
+    else if(c >= '1' && c <= '8')
+      x += c - '0';
+    else {
+      const char* found = strchr(letters, c | 0x20);
+      if(found == nullptr || x > 7)
+	return nullptr;
+      Player owner = (c & 0x20) ? BLACK : WHITE;
+      int type = types[found - letters];
+      if(type == KING_ENUM)
+	kings[owner]++;
+      position.squares[y * 8 + x++] = BoardState::code(type, owner);
+    }
+    if(x > 8)
+      return nullptr;
+  }
+  if(x != 8 || y != 0 || kings[WHITE] != 1 || kings[BLACK] != 1)
+    return nullptr;
+
+  //side to move, then castling and en passant (skipped), then the clocks
+  const char* fields[5];
+  const char* ends[5];
+  int count = 0;
+  while(count < 5){
+    while(s < end && is_space(*s))
+      s++;
+    if(s == end || *s == '"')
+      break;
+    fields[count] = s;
+    while(s < end && !is_space(*s) && *s != '"' && *s != ';')
+      s++;
+    ends[count++] = s;
+  }
+  if(count < 1 || ends[0] - fields[0] != 1 || (*fields[0] != 'w' && *fields[0] != 'b'))
+    return nullptr;
+  position.to_move = *fields[0] == 'w' ? WHITE : BLACK;
+  position.halfmove = count > 3 ? std::atoi(fields[3]) : 0;
+  int fullmove = count > 4 ? std::atoi(fields[4]) : 1;
+  position.ply = 2 * (fullmove > 0 ? fullmove - 1 : 0) + (position.to_move == BLACK ? 1 : 0);
+  return count > 0 ? ends[count - 1] : s;
+}
+
+
+// Parses the games of one chunk with one worker's scratch games
+class PgnReader {
+
+public:
+
+  PgnReader(GameImporter& importer, int worker) :
+    _importer(importer), _worker(worker), _game(nullptr), _in_moves(false), _in_comment(false), _depth(0),
+    _offset(0), _line(0) {
+    reset();
+  }
+
+  // Hand every finished game's records to the writer
+  ~PgnReader(){
+    finish();
+    flush();
+  }
+
+  // A line starting at offset in the file
+  void line(const char* s, const char* end, uint64_t offset){
+    _line = offset;
+    if(_in_comment || _depth > 0){ //a comment or variation from an earlier line
+      moves(s, end);
+      return;
+    }
+    while(s < end && is_space(*s))
+      s++;
+    while(end > s && is_space(end[-1]))
+      end--;
+    if(s == end || *s == '%')
+      return;
+    if(*s == '['){
+      if(_in_moves)
+	finish();
+      opened();
+      tag(s + 1, end);
+      return;
+    }
+    TrainingPosition position;
+    const char* rest = parse_fen(s, end, position);
+    if(rest != nullptr){
+      finish();
+      opened();
+      fen_line(position, rest, end);
+      return;
+    }
+    opened();
+    moves(s, end);
+  }
+
+private:
+
+  GameImporter& _importer;
+  int _worker;
+  vector<uint8_t> _records;
+  size_t _first;         // this game's first record in _records
+
+  // The game being read
+  int _variant;
+  int _result;           // for white, NO_RESULT until known
+  bool _has_fen;
+  TrainingPosition _fen; // start position given by a FEN tag
+  bool _rejected;        // not importable, e.g. another variant
+  bool _dead;            // a move could not be played; the rest is skipped
+  ChessGame* _game;      // nullptr until the first move is read
+  int _ply;
+
+  bool _in_moves;        // reading movetext
+  bool _in_comment;      // inside { }
+  int _depth;            // nesting of ( ) variations
+
+  // For the position index
+  bool _opened;          // a line of this game has been read
+  uint64_t _offset;      // where the game starts in the file
+  uint64_t _line;        // where the current line starts
+  vector<uint64_t> _keys; // positions the game reached
+
+  void reset(){
+    _variant = STANDARD_CHESS;
+    _result = NO_RESULT;
+    _has_fen = false;
+    _rejected = _dead = false;
+    _game = nullptr;
+    _ply = 0;
+    _in_moves = _in_comment = false;
+    _depth = 0;
+    _first = _records.size();
+    _opened = false;
+    _keys.clear();
+  }
+
+  // Note where the game starts at its first line
+  void opened(){
+    if(!_opened)
+      _offset = _line;
+    _opened = true;
+  }
+
+  void flush(){
+    int count = _first / RECORD_SIZE;
+    if(count > 0){
+      _importer._writer.add(_records.data(), count);
+      _importer._positions += count;
+    }
+    _records.erase(_records.begin(), _records.begin() + _first);
+    _first = 0;
+  }
+
+  // End the game being read: keep its records if its result is known
+  void finish(){
+    bool started = _in_moves || _result != NO_RESULT || _has_fen;
+    if(!started){
+      reset();
+      return;
+    }
+    if(_result == NO_RESULT || _rejected || _game == nullptr){
+      _records.resize(_first);
+      _importer._rejected++;
+    }
+    else {
+      for(size_t r = _first; r < _records.size(); r += RECORD_SIZE)
+	set_result(&_records[r], _result);
+      if(_importer._index != nullptr){
+	_keys.push_back(PositionIndex::key(*_game, _variant));
+	_importer._index->add_game(_importer._source, _offset, _keys.data(), _keys.size());
+      }
+      _importer._games++;
+      if(_dead)
+	_importer._truncated++;
+    }
+    bool full = _records.size() >= FLUSH_RECORDS * RECORD_SIZE;
+    _first = _records.size();
+    if(full)
+      flush();
+    reset();
+  }
+
+  // A tag pair: [Name "value"]
+  void tag(const char* s, const char* end){
+    const char* name = s;
+    while(s < end && !is_space(*s))
+      s++;
+    size_t length = s - name;
+    const char* value = (const char*)memchr(s, '"', end - s);
+    if(value == nullptr)
+      return;
+    value++;
+    const char* value_end = (const char*)memchr(value, '"', end - value);
+    if(value_end == nullptr)
+      return;
+    if(length == 6 && memcmp(name, "Result", 6) == 0)
+      _result = result_token(value, value_end);
+    else if(length == 3 && memcmp(name, "FEN", 3) == 0){
+      _has_fen = parse_fen(value, value_end, _fen) != nullptr;
+      if(!_has_fen)
+	_rejected = true;
+    }
+    else if(length == 7 && memcmp(name, "Variant", 7) == 0){
+      string variant(value, value_end); //once per game at most
+      for(size_t i = 0; i < variant.size(); i++)
+	variant[i] |= 0x20;
+      if(variant.find("hill") != string::npos)
+	_variant = KING_OF_THE_HILL;
+      else if(variant != "standard" && variant != "from position")
+	_rejected = true;
+    }
+  }
+
+  // A FEN line: the position and the result of the game it comes from
+  void fen_line(TrainingPosition& position, const char* s, const char* end){
+    int result = NO_RESULT;
+    while(s < end && result == NO_RESULT){
+      while(s < end && (is_space(*s) || *s == '"' || *s == ';'))
+	s++;
+      const char* token = s;
+      while(s < end && !is_space(*s) && *s != '"' && *s != ';')
+	s++;
+      result = result_token(token, s);
+    }
+    if(result == NO_RESULT){
+      _importer._rejected++;
+      return;
+    }
+    ChessGame* game = scratch(STANDARD_CHESS);
+    if(!load_position(*game, position)){
+      _importer._rejected++;
+      return;
+    }
+    _records.resize(_records.size() + RECORD_SIZE);
+    uint8_t* record = &_records[_records.size() - RECORD_SIZE];
+    pack_position(*game, STANDARD_CHESS, 0, position.ply, record);
+    set_result(record, result);
+    if(_importer._index != nullptr){
+      uint64_t key = PositionIndex::key(*game, STANDARD_CHESS);
+      _importer._index->add_game(_importer._source, _offset, &key, 1);
+    }
+    _importer._games++;
+    _first = _records.size();
+  }
+
+  ChessGame* scratch(int variant){
+    ChessGame*& game = _importer._scratch[_worker * (SPOOKY_CHESS + 1) + variant];
+    if(game == nullptr)
+      game = create_game(variant, "");
+    return game;
+  }
+
+  // Set up the board the game starts from
+  void start(){
+    _game = scratch(_variant);
+    if(_has_fen){
+      load_position(*_game, _fen);
+      _ply = _fen.ply;
+    }
+    else
+      _game->import_state(_importer._start[_variant]);
+  }
+
+  // Movetext: move numbers, SAN moves, comments, variations, NAGs and the result
+  void moves(const char* s, const char* end){
+    _in_moves = true;
+    while(s < end){
+      char c = *s;
+      if(_in_comment){
+	const char* close = (const char*)memchr(s, '}', end - s);
+	if(close == nullptr)
+	  return;
+	_in_comment = false;
+	s = close + 1;
+	continue;
+      }
+      if(c == '{'){ _in_comment = true; s++; continue; }
+      if(c == ';') return; //comment to the end of the line
+      if(c == '('){ _depth++; s++; continue; }
+      if(c == ')'){ if(_depth > 0) _depth--; s++; continue; }
+      if(is_space(c) || _depth > 0){ s++; continue; }
+      const char* token = s;
+      while(s < end && !is_space(*s) && !strchr("{}();", *s))
+	s++;
+      if(*token == '$') //numeric annotation glyph
+	continue;
+      int result = result_token(token, s);
+      if(result != NO_RESULT || (s - token == 1 && *token == '*')){
+	if(result != NO_RESULT)
+	  _result = result;
+	finish();
+	continue;
+      }
+      while(token < s && *token >= '0' && *token <= '9') //move number
+	token++;
+      while(token < s && *token == '.')
+	token++;
+      if(token < s)
+	san(token, s);
+    }
+  }
+
+  // Play one move written in SAN, recording the position it is played from
+  void san(const char* s, const char* end){
+    if(_rejected || _dead)
+      return;
+    if(_game == nullptr)
+      start();
+    while(end > s && strchr("+#!?", end[-1]))
+      end--;
+    if(s == end)
+      return;
+    if(*s == 'O' || *s == '0'){ //castling
+      _dead = true;
+      return;
+    }
+    int type = san_piece(*s);
+    if(type >= 0)
+      s++;
+    else
+      type = PAWN_ENUM;
+    char promotion = 0; //only to a queen here
+    if(end - s >= 2 && end[-2] == '='){
+      promotion = end[-1];
+      end -= 2;
+    }
+    else if(end - s >= 1 && san_piece(end[-1]) >= 0)
+      promotion = *--end;
+    if((promotion != 0 && promotion != 'Q') || end - s < 2 || end[-2] < 'a' || end[-2] > 'h' || end[-1] < '1' || end[-1] > '8'){
+      _dead = true;
+      return;
+    }
+    int to_x = end[-2] - 'a', to_y = end[-1] - '1';
+    int from_x = -1, from_y = -1; //disambiguation
+    for(const char* c = s; c < end - 2; c++){
+      if(*c >= 'a' && *c <= 'h')
+	from_x = *c - 'a';
+      else if(*c >= '1' && *c <= '8')
+	from_y = *c - '1';
+    }
+
+    //the one piece of that type that can legally make the move
+    Player me = _game->player_turn();
+    LegalMasks masks;
+    _game->compute_masks(masks);
+    int to = to_y * 8 + to_x, from = -1;
+    for(int y = 0; y < 8; y++){
+      if(from_y >= 0 && y != from_y)
+	continue;
+      for(int x = 0; x < 8; x++){
+	if(from_x >= 0 && x != from_x)
+	  continue;
+	const Piece* p = _game->get_piece(Position(x, y));
+	if(p == nullptr || p->owner() != me || p->piece_type() != type)
+	  continue;
+	if(_game->valid_move(Position(x, y), Position(to_x, to_y)) < 0 || !_game->legal_target(y * 8 + x, to, masks))
+	  continue;
+	if(from >= 0){ //ambiguous
+	  _dead = true;
+	  return;
+	}
+	from = y * 8 + x;
+      }
+    }
+    if(from < 0){ //en passant, or not legal at all
+      _dead = true;
+      return;
+    }
+    _records.resize(_records.size() + RECORD_SIZE);
+    pack_position(*_game, _variant, 0, _ply, &_records[_records.size() - RECORD_SIZE]);
+    uint64_t key = _importer._index != nullptr ? PositionIndex::key(*_game, _variant) : 0;
+    if(_game->play_turn(Move(from, to)) < 0){
+      _records.resize(_records.size() - RECORD_SIZE);
+      _dead = true;
+      return;
+    }
+    if(_importer._index != nullptr)
+      _keys.push_back(key);
+    _ply++;
+  }
+
+};
+
+
+GameImporter::GameImporter(TrainingWriter& writer, int threads, PositionIndexBuilder* index) :
+  _writer(writer), _index(index), _pool(threads), _games(0), _positions(0), _truncated(0), _rejected(0), _bytes(0),
+  _scratch(_pool.size() * (SPOOKY_CHESS + 1), nullptr), _buffers(0) {
+  for(int variant = STANDARD_CHESS; variant <= SPOOKY_CHESS; variant++){
+    ChessGame* game = create_game(variant, "");
+    game->export_state(_start[variant]);
+    delete game;
+  }
+}
+
+GameImporter::~GameImporter(){
+  _pool.wait();
+  for(size_t i = 0; i < _scratch.size(); i++)
+    delete _scratch[i];
+  for(size_t i = 0; i < _free.size(); i++)
+    delete _free[i];
+}
+
+std::vector<char>* GameImporter::take_buffer(){
+  std::unique_lock<std::mutex> guard(_lock);
+  if(_free.empty() && _buffers < 2 * _pool.size() + 1){ //enough to keep every worker busy while reading
+    _buffers++;
+    return new vector<char>(CHUNK);
+  }
+  _returned.wait(guard, [this](){ return !_free.empty(); });
+  vector<char>* buffer = _free.back();
+  _free.pop_back();
+  return buffer;
+}
+
+void GameImporter::return_buffer(vector<char>* buffer){
+  std::lock_guard<std::mutex> guard(_lock);
+  _free.push_back(buffer);
+  _returned.notify_one();
+}
+
+void GameImporter::parse(const char* begin, const char* end, uint64_t offset, int worker){
+  PgnReader reader(*this, worker);
+  const char* chunk = begin;
+  while(begin < end){
+    const char* newline = (const char*)memchr(begin, '\n', end - begin);
+    const char* line_end = newline != nullptr ? newline : end;
+    reader.line(begin, line_end, offset + (begin - chunk));
+    begin = line_end + 1;
+  }
+}
+
+// Return where the last game in [0, size) starts: at a tag line that follows
+// a blank line or movetext, or for FEN lines after the last newline.
+// Returns 0 if no game starts after the first.
+static size_t cut(const char* text, size_t size){
+  bool tags = false;
+  for(size_t p = size; p-- > 1;){
+    if(text[p] != '[' || text[p - 1] != '\n')
+      continue;
+    tags = true;
+    size_t start = p - 1; //find the line before
+    while(start > 0 && text[start - 1] != '\n')
+      start--;
+    const char* line = text + start;
+    while(line < text + p && is_space(*line))
+      line++;
+    if(line == text + p || *line != '[')
+      return p;
+  }
+  if(tags || memchr(text, '[', size) != nullptr)
+    return 0;
+  for(size_t p = size; p-- > 0;){
+    if(text[p] == '\n')
+      return p + 1;
+  }
+  return 0;
+}
+
+bool GameImporter::import(const string& path){
+  int fd = (path == "-") ? 0 : open(path.c_str(), O_RDONLY);
+  if(fd < 0)
+    return false;
+  posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+  _source = path;
+  vector<char>* buffer = take_buffer();
+  size_t filled = 0;
+  uint64_t offset = 0; //of the buffer in the file
+  bool eof = false, failed = false;
+  while(!eof){
+    while(filled < buffer->size()){
+      ssize_t n = read(fd, buffer->data() + filled, buffer->size() - filled);
+      if(n <= 0){
+	eof = true;
+	failed = n < 0;
+	break;
+      }
+      filled += n;
+      _bytes += n;
+    }
+    size_t end = eof ? filled : cut(buffer->data(), filled);
+    if(end == 0 && !eof){ //one game bigger than the buffer
+      buffer->resize(buffer->size() * 2);
+      continue;
+    }
+    vector<char>* next = take_buffer();
+    if(next->size() < filled - end)
+      next->resize(filled - end);
+    memcpy(next->data(), buffer->data() + end, filled - end);
+    _pool.submit([this, buffer, end, offset](int worker){
+	parse(buffer->data(), buffer->data() + end, offset, worker);
+	return_buffer(buffer);
+      });
+    buffer = next;
+    filled -= end;
+    offset += end;
+  }
+  return_buffer(buffer);
+  _pool.wait();
+  if(fd != 0)
+    close(fd);
+  return !failed;
+}
+
+int GameImporter::main(const vector<string>& args){
+  int threads = ThreadPool::hardware_threads();
+  long shard_size = 0;
+  string output, index_path;
+  vector<string> paths;
+  for(size_t i = 0; i < args.size(); i++){
+    bool has_value = i + 1 < args.size();
+    if(args[i] == "--threads" && has_value)
+      threads = std::atoi(args[++i].c_str());
+    else if(args[i] == "--shard-size" && has_value)
+      shard_size = std::atol(args[++i].c_str());
+    else if(args[i] == "--out" && has_value)
+      output = args[++i];
+    else if(args[i] == "--index" && has_value)
+      index_path = args[++i];
+    else
+      paths.push_back(args[i]);
+  }
+  if(output.empty() || paths.empty()){
+    std::cerr << "Usage: play import [--threads N] [--shard-size N] [--index FILE] --out PATH <PGN or FEN file, or ->...\n";
+    return 1;
+  }
+
+  TrainingWriter writer;
+  if(!writer.open(output, shard_size)){
+    std::cerr << "Can't write training data to " << output << "\n";
+    return 1;
+  }
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  bool ok = true;
+  {
+    std::unique_ptr<PositionIndexBuilder> index;
+    if(!index_path.empty())
+      index.reset(new PositionIndexBuilder(index_path));
+    GameImporter importer(writer, threads, index.get());
+    for(size_t i = 0; i < paths.size(); i++){
+      if(!importer.import(paths[i])){
+	std::cerr << "Can't read " << paths[i] << "\n";
+	ok = false;
+      }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "games " << importer.games() << " positions " << importer.positions()
+	      << " truncated " << importer.truncated() << " rejected " << importer.rejected()
+	      << " time " << seconds << "s";
+    if(seconds > 0)
+      std::cout << " MB/s " << importer.bytes() / seconds / 1e6;
+    std::cout << std::endl;
+    if(index && !index->flush()){
+      std::cerr << "Can't update the position index " << index_path << "\n";
+      ok = false;
+    }
+  }
+  if(!writer.close()){
+    std::cerr << "Writing " << output << " failed\n";
+    return 1;
+  }
+  return ok ? 0 : 1;
+}
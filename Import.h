@@ -0,0 +1,93 @@
+#ifndef IMPORT_H
+#define IMPORT_H
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include "BoardState.h"
+#include "ThreadPool.h"
+#include "TrainingData.h"
+#include "PositionIndex.h"
+
+class ChessGame;
+
+// Bulk import of games in standard notation into training records.
+// Accepts PGN (optionally with FEN and Variant tags; "King of the Hill"
+// games are played as such) and lines holding a FEN followed by the game's
+// result. Every position a move is played from is recorded with the result
+// of its game and a score of 0, so tune such data with --lambda 1.
+//
+// The input is read in large chunks cut at game boundaries, and each chunk
+// is parsed in place on a ThreadPool, one task per chunk: tokens are
+// pointers into the chunk and the chunk buffers are reused, so nothing is
+// allocated per token or per game. Moves are matched against the board and
+// replayed with play_turn. The rules here have no castling, en passant or
+// underpromotion; a game reaching one of those keeps the positions before
+// it and is counted as truncated. With a PositionIndexBuilder, every game
+// recorded is also added to the position index.
+class GameImporter {
+
+public:
+
+    // Bytes read per chunk; a chunk grows if a single game doesn't fit
+    static const size_t CHUNK = 8 << 20;
+
+    GameImporter(TrainingWriter& writer, int threads, PositionIndexBuilder* index = nullptr);
+
+    // Frees the games and chunk buffers
+    ~GameImporter();
+
+    GameImporter(const GameImporter&) = delete;
+    GameImporter& operator=(const GameImporter&) = delete;
+
+    // Import a file, or standard input for "-". Returns false if it can't be read.
+    bool import(const std::string& path);
+
+    long games() const { return _games; }          // games or FEN lines recorded
+    long positions() const { return _positions; }  // records written
+    long truncated() const { return _truncated; }  // games cut short at a move the rules lack
+    long rejected() const { return _rejected; }    // games without a result, of another variant, or unreadable
+    long bytes() const { return _bytes; }          // bytes read
+
+    // Command-line entry: play import [--threads N] [--shard-size N] [--index FILE] --out PATH <file or ->...
+    static int main(const std::vector<std::string>& args);
+
+private:
+
+    TrainingWriter& _writer;
+    PositionIndexBuilder* _index; // nullptr if not indexing
+    std::string _source;          // file being imported
+    ThreadPool _pool;
+    std::atomic<long> _games, _positions, _truncated, _rejected;
+    long _bytes;
+
+    // Position every variant starts from, indexed by GameName
+    BoardState _start[4];
+
+    // Per worker, one game of each variant (indexed by GameName) to replay games on
+    std::vector<ChessGame*> _scratch;
+
+    // Chunk buffers not being parsed, and the number in all
+    std::mutex _lock;
+    std::condition_variable _returned;
+    std::vector<std::vector<char>*> _free;
+    int _buffers;
+
+    // Take a free chunk buffer, waiting if every one is being parsed
+    std::vector<char>* take_buffer();
+
+    // Give a chunk buffer back once it is parsed
+    void return_buffer(std::vector<char>* buffer);
+
+    // Parse the games in [begin, end), which starts at offset in the file,
+    // and hand their records to the writer
+    void parse(const char* begin, const char* end, uint64_t offset, int worker);
+
+    friend class PgnReader;
+
+};
+
+#endif // IMPORT_H
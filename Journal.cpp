@@ -0,0 +1,174 @@
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <exception>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include "ChessGame.h"
+#include "SpookyChess.h"
+#include "Variants.h"
+#include "PositionIndex.h"
+#include "Journal.h"
+
+using std::string;
+
+// First word of every journal
+static const char* MAGIC = "CGJ2";
+
+Journal::~Journal(){
+  close();
+}
+
+void Journal::close(){
+  flush();
+  if(_fd >= 0){
+    ::close(_fd);
+    if(_index != nullptr)
+      _index->add_journal(_path);
+  }
+  _fd = -1;
+}
+
+bool Journal::start(const string& path, int game, const string& snapshot){
+  close();
+  _path = path;
+  _game = game;
+  _fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+  if(_fd < 0)
+    return false;
+  string header = string(MAGIC) + " " + game_token(game) + " " + (snapshot.empty() ? "-" : snapshot) + "\n";
+  return write(_fd, header.data(), header.size()) == (ssize_t)header.size();
+}
+
+bool Journal::resume(const string& path, long kept){
+  close();
+  std::ifstream file(path);
+  string magic, token;
+  if(!(file >> magic >> token) || magic != MAGIC)
+    return false;
+  _path = path;
+  _game = 0;
+  for(int g = STANDARD_CHESS; g <= SPOOKY_CHESS; g++){
+    if(token == game_token(g))
+      _game = g;
+  }
+  _fd = open(path.c_str(), O_WRONLY | O_APPEND);
+  if(_fd >= 0 && ftruncate(_fd, kept) != 0){
+    ::close(_fd);
+    _fd = -1;
+  }
+  return _fd >= 0;
+}
+
+void Journal::append(Move m){
+  if(_fd < 0)
+    return;
+  _buffer.push_back((char)(m.bits() & 0xff));
+  _buffer.push_back((char)(m.bits() >> 8));
+  if(++_pending >= _batch)
+    flush();
+}
+
+// Draws only get 6 bits, so a ghost that needs more first stays where it is
+// in records of 63 draws each
+void Journal::record_ghost(int from, int square, int draws){
+  for(; draws > 63; draws -= 63)
+    append(Move(from, 63, Move::GHOST));
+  append(Move(square, draws, Move::GHOST));
+}
+
+// One write per batch, repeated for what a short write left. A crash can
+// at worst cut off the last record, which recovery skips and resume cuts
+// off. Once a write fails the rest of the game would not line up with what
+// is on disk, so the journal stops there.
+bool Journal::flush(){
+  size_t done = 0;
+  while(_fd >= 0 && done < _buffer.size()){
+    ssize_t written = write(_fd, _buffer.data() + done, _buffer.size() - done);
+    if(written < 0 && errno == EINTR)
+      continue;
+    if(written <= 0){
+      ::close(_fd);
+      _fd = -1;
+      _buffer.clear();
+      _pending = 0;
+      return false;
+    }
+    done += written;
+  }
+  _buffer.clear();
+  _pending = 0;
+  return true;
+}
+
+// Read the header line of the journal in file. Returns the GameName, 0 if
+// it isn't a journal.
+static int read_header(std::ifstream& file, string& snapshot){
+  string line;
+  if(!std::getline(file, line))
+    return 0;
+  std::istringstream header(line);
+  string magic, token;
+  header >> magic >> token;
+  std::getline(header >> std::ws, snapshot); //the rest of the line, spaces included
+  int game = 0;
+  for(int g = STANDARD_CHESS; g <= SPOOKY_CHESS; g++){
+    if(token == game_token(g))
+      game = g;
+  }
+  if(magic != MAGIC)
+    return 0;
+  return game;
+}
+
+int Journal::game_of(const string& path){
+  std::ifstream file(path, std::ios::binary);
+  string snapshot;
+  return read_header(file, snapshot);
+}
+
+ChessGame* Journal::recover(const string& path, std::vector<uint64_t>* positions, JournalTail* tail){
+  std::ifstream file(path, std::ios::binary);
+  string snapshot;
+  int game = read_header(file, snapshot);
+  if(game == 0)
+    return nullptr;
+
+  ChessGame* result = nullptr;
+  try {
+    result = create_game(game, snapshot == "-" ? "" : snapshot);
+  }
+  catch(std::exception& e){
+    return nullptr;
+  }
+  SpookyChess* spooky = dynamic_cast<SpookyChess*>(result);
+
+  long kept = (long)file.tellg();
+  char record[2];
+  while(file.read(record, 2)){ //a cut-off last record is left out
+    Move m = Move::from_bits((unsigned char)record[0] | ((unsigned char)record[1] << 8));
+    if(m.is(Move::GHOST)){
+      if(spooky != nullptr)
+	spooky->replay_ghost(m.from(), m.to());
+    }
+    else{
+      uint64_t hash = result->position_hash();
+      if(result->replay_move(m) < 0)
+	break; //the journal doesn't match its snapshot, keep what is valid
+      if(positions != nullptr)
+	positions->push_back(hash);
+    }
+    kept += 2;
+  }
+  if(positions != nullptr)
+    positions->push_back(result->position_hash());
+  if(tail != nullptr){
+    file.clear();
+    file.seekg(0, std::ios::end);
+    tail->kept = kept;
+    tail->dropped = (long)file.tellg() - kept;
+  }
+  return result;
+}
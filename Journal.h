@@ -0,0 +1,98 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "Enumerations.h"
+#include "Move.h"
+
+class ChessGame;
+class PositionIndexBuilder;
+
+// Where the records recover could use end in a journal
+struct JournalTail {
+    long kept;     // bytes of the header and every record replayed
+    long dropped;  // bytes after them: a record cut off by a crash, or records that don't replay
+};
+
+// Append-only record of a game's moves since its last snapshot (a save file,
+// or the initial position of a new game). The file starts with a text line
+//     CGJ2 <game token> <snapshot file, or - for a new game>
+// followed by one 16-bit Move per record, low byte first. Ghost landings in
+// Spooky Chess are Moves flagged GHOST. Records are buffered and written in
+// batches, so a move costs two bytes of I/O instead of rewriting the game.
+class Journal {
+
+public:
+
+    // Records kept in memory before they are written out
+    static const int DEFAULT_BATCH = 8;
+
+    explicit Journal(int batch = DEFAULT_BATCH) : _fd(-1), _batch(batch), _pending(0), _index(nullptr) {}
+
+    // Flushes the pending records and closes the file
+    ~Journal();
+
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+
+    // Start a new journal at path for a game of the given GameName whose
+    // moves are played on top of snapshot ("" for a new game). Truncates the
+    // file. Returns false if it can't be written.
+    bool start(const std::string& path, int game, const std::string& snapshot);
+
+    // Start over on top of a new snapshot, keeping the same file and game
+    bool restart(const std::string& snapshot) { return start(_path, _game, snapshot); }
+
+    // Reopen an existing journal to append to it after recovery, first
+    // cutting it to the kept bytes recover reported, so that new records
+    // follow the last one replayed and start on a whole record
+    bool resume(const std::string& path, long kept);
+
+    // Return true if a file is open
+    bool is_open() const { return _fd >= 0; }
+
+    // Add the journaled game to index (not owned) whenever the file is
+    // closed: at the end of the game, and before a restart empties it
+    void attach_index(PositionIndexBuilder* index) { _index = index; }
+
+    // Append a player's move
+    void record_move(Move m) { append(m); }
+
+    // Append where the ghost, standing on from, landed and how many random numbers it took
+    void record_ghost(int from, int square, int draws);
+
+    // Write out any pending records. If they can't all be written, the
+    // file is closed and nothing more is journaled. Returns false then.
+    bool flush();
+
+    // Rebuild the game recorded in the journal at path: load its snapshot
+    // and replay every complete record. Returns nullptr if the journal or
+    // its snapshot can't be read. Caller owns the result. If positions is
+    // given, the position_hash of every position a move was played from,
+    // and of the last one, is added to it. If tail is given, it is set to
+    // where the replayed records end.
+    static ChessGame* recover(const std::string& path, std::vector<uint64_t>* positions = nullptr,
+                              JournalTail* tail = nullptr);
+
+    // Return the GameName of the journal at path, 0 if it isn't a journal
+    static int game_of(const std::string& path);
+
+private:
+
+    std::string _path;
+    int _fd;             // file descriptor opened for appending
+    int _game;           // GameName of the journaled game
+    int _batch;          // records per write
+    int _pending;        // records waiting in _buffer
+    std::vector<char> _buffer;
+    PositionIndexBuilder* _index; // nullptr if not indexing
+
+    void append(Move m);
+
+    void close();
+
+};
+
+#endif // JOURNAL_H
@@ -0,0 +1,130 @@
+#include <string>
+#include <exception>
+#include "Game.h"
+#include "ChessGame.h"
+#include "Move.h"
+#include "Variants.h"
+#include "LibChessGame.h"
+
+struct cg_game {
+  ChessGame* game;
+  int variant;
+};
+
+static_assert((int)CG_LOAD_FAILURE == (int)LOAD_FAILURE && (int)CG_MOVE_ERROR_ILLEGAL == (int)MOVE_ERROR_ILLEGAL
+	      && (int)CG_SUCCESS == (int)SUCCESS && (int)CG_GAME_OVER == (int)GAME_OVER, "status codes differ");
+static_assert((int)CG_STANDARD_CHESS == (int)STANDARD_CHESS && (int)CG_SPOOKY_CHESS == (int)SPOOKY_CHESS, "variants differ");
+
+static cg_game* wrap(ChessGame* game, int variant){
+  if(game == nullptr)
+    return nullptr;
+  cg_game* handle = new cg_game;
+  handle->game = game;
+  handle->variant = variant;
+  return handle;
+}
+
+cg_game* cg_new(int variant){
+  return wrap(create_game(variant, ""), variant);
+}
+
+cg_game* cg_load(const char* path){
+  if(path == nullptr)
+    return nullptr;
+  int variant = detect_game(path);
+  if(variant == 0)
+    return nullptr;
+  try {
+    return wrap(create_game(variant, path), variant);
+  }
+  catch(std::exception& e){
+    return nullptr;
+  }
+}
+
+cg_game* cg_clone(const cg_game* game){
+  return wrap(game->game->clone(), game->variant);
+}
+
+void cg_free(cg_game* game){
+  if(game == nullptr)
+    return;
+  delete game->game;
+  delete game;
+}
+
+int cg_variant(const cg_game* game){
+  return game->variant;
+}
+
+int cg_turn(const cg_game* game){
+  return game->game->turn();
+}
+
+int cg_player_to_move(const cg_game* game){
+  return game->game->player_turn();
+}
+
+int cg_piece_at(const cg_game* game, int square, int* owner){
+  const ChessGame& g = *game->game;
+  if(square < 0 || square >= (int)(g.width() * g.height()))
+    return -1;
+  const Piece* p = g.get_piece(Position(square % g.width(), square / g.width()));
+  if(p == nullptr)
+    return -1;
+  if(owner != nullptr)
+    *owner = p->owner();
+  return p->piece_type();
+}
+
+// Status of a move in a game, before anything is played
+static int check(ChessGame& g, const cg_move& m){
+  if(m.from < 0 || m.from > 63 || m.to < 0 || m.to > 63) //can't be packed into a Move
+    return MOVE_ERROR_OUT_OF_BOUNDS;
+  return g.check_turn(Move(m.from, m.to));
+}
+
+int cg_validate_moves(cg_game* const* games, const cg_move* moves, int count, int* results){
+  int legal = 0;
+  for(int i = 0; i < count; i++){
+    results[i] = check(*games[i]->game, moves[i]);
+    if(results[i] > 0)
+      legal++;
+  }
+  return legal;
+}
+
+int cg_apply_moves(cg_game* const* games, const cg_move* moves, int count, int* results){
+  int played = 0;
+  for(int i = 0; i < count; i++){
+    ChessGame& g = *games[i]->game;
+    results[i] = check(g, moves[i]);
+    if(results[i] < 0)
+      continue;
+    results[i] = g.play_checked_turn(Move(moves[i].from, moves[i].to), results[i]);
+    if(results[i] > 0)
+      played++;
+  }
+  return played;
+}
+
+int cg_legal_moves(cg_game* const* games, int count, cg_move* out, int capacity, int* counts){
+  int total = 0;
+  for(int i = 0; i < count; i++){
+    MoveList moves;
+    games[i]->game->legal_moves(moves);
+    counts[i] = moves.size();
+    total += moves.size();
+    for(int j = 0; j < moves.size() && j < capacity; j++){
+      cg_move& m = out[(long)i * capacity + j];
+      m.from = moves[j].from();
+      m.to = moves[j].to();
+    }
+  }
+  return total;
+}
+
+void cg_outcomes(cg_game* const* games, int count, int* outcomes){
+  for(int i = 0; i < count; i++)
+    outcomes[i] = games[i]->game->outcome();
+}
@@ -0,0 +1,106 @@
+#ifndef LIB_CHESS_GAME_H
+#define LIB_CHESS_GAME_H
+
+/* C interface to the rules engine in libchessgame.a. Nothing here prints
+ * or reads the terminal. Every call that takes an array of games works on
+ * count games at once, so a service can handle many games per call. A game
+ * must not be used by two threads at the same time; different games may be. */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* A game of any variant, from cg_new, cg_load or cg_clone, freed by cg_free */
+typedef struct cg_game cg_game;
+
+/* A move between two squares, numbered row by row from a1 = 0, b1 = 1 to h8 = 63 */
+typedef struct {
+    int from;
+    int to;
+} cg_move;
+
+/* Variants */
+enum {
+    CG_STANDARD_CHESS = 1,
+    CG_KING_OF_THE_HILL,
+    CG_SPOOKY_CHESS
+};
+
+/* Status codes: > 0 a move was (or would be) made, < 0 it was rejected.
+ * The same values as the status enum of the C++ code. */
+enum {
+    CG_LOAD_FAILURE = -10,
+    CG_SAVE_FAILURE,
+    CG_PARSE_ERROR,
+    CG_MOVE_ERROR_OUT_OF_BOUNDS,
+    CG_MOVE_ERROR_NO_PIECE,
+    CG_MOVE_ERROR_BLOCKED,
+    CG_MOVE_ERROR_CANT_CASTLE,
+    CG_MOVE_ERROR_MUST_HANDLE_CHECK,
+    CG_MOVE_ERROR_CANT_EXPOSE_CHECK,
+    CG_MOVE_ERROR_ILLEGAL,
+    CG_SUCCESS = 1,
+    CG_MOVE_CHECK,
+    CG_MOVE_CAPTURE,
+    CG_GHOST_CAPTURE,
+    CG_CHECKMATE,
+    CG_STALEMATE,
+    CG_DRAW,
+    CG_GAME_WIN,
+    CG_GAME_OVER
+};
+
+/* Start a new game of a variant. Returns NULL for an unknown variant. */
+cg_game* cg_new(int variant);
+
+/* Load a saved game, of the variant named in its header. Returns NULL if
+ * the file can't be read or loaded. */
+cg_game* cg_load(const char* path);
+
+/* Return an independent copy of a game */
+cg_game* cg_clone(const cg_game* game);
+
+/* Free a game; NULL is ignored */
+void cg_free(cg_game* game);
+
+/* Return the variant of a game */
+int cg_variant(const cg_game* game);
+
+/* Return the turn number, counting from 1 */
+int cg_turn(const cg_game* game);
+
+/* Return 0 if white is to move, 1 if black is */
+int cg_player_to_move(const cg_game* game);
+
+/* Return the piece type on square (0 pawn, 1 rook, 2 knight, 3 bishop,
+ * 4 queen, 5 king, 6 ghost) and store its owner (0 white, 1 black, 2 no
+ * one) in *owner if owner is not NULL. Returns -1 for an empty square or
+ * one off the board. */
+int cg_piece_at(const cg_game* game, int square, int* owner);
+
+/* Check moves[i] in games[i] for each i < count without playing it, and
+ * store its status in results[i]. A game that is over accepts no move
+ * (CG_MOVE_ERROR_ILLEGAL). Returns how many moves are legal. */
+int cg_validate_moves(cg_game* const* games, const cg_move* moves, int count, int* results);
+
+/* Play moves[i] in games[i] for each i < count, as a whole turn (in Spooky
+ * Chess the ghost then moves), and store its status in results[i]: that of
+ * the move, or CG_GHOST_CAPTURE if the ghost then took a piece. Rejected
+ * moves leave their game unchanged. Returns how many moves were played. */
+int cg_apply_moves(cg_game* const* games, const cg_move* moves, int count, int* results);
+
+/* Store the legal moves of games[i] in out[i * capacity] onwards, at most
+ * capacity of them, and their number in counts[i]. A count larger than
+ * capacity means some were left out; 256 is always enough. Returns the
+ * total number of legal moves. */
+int cg_legal_moves(cg_game* const* games, int count, cg_move* out, int capacity, int* counts);
+
+/* Store how each game stands in outcomes[i]: 0 while it goes on, or
+ * CG_CHECKMATE, CG_STALEMATE, CG_DRAW or CG_GAME_WIN (king of the hill). */
+void cg_outcomes(cg_game* const* games, int count, int* outcomes);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LIB_CHESS_GAME_H */
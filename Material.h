@@ -0,0 +1,55 @@
+#ifndef MATERIAL_H
+#define MATERIAL_H
+
+#include <cstdint>
+#include "Enumerations.h"
+#include "Piece.h"
+
+// Material signatures: how many pieces of each kind each player has, in
+// one integer with BITS bits per kind and player. A game keeps its
+// signature up to date by adding or subtracting unit() as pieces are
+// placed, captured and promoted, and an endgame is recognised by comparing
+// the signature whole against a constant. The ghost is not counted.
+class Material {
+
+public:
+
+    // Bits per count, enough for every piece a 64-square board can hold
+    static const int BITS = 5;
+
+    // The signature of a single piece
+    static constexpr uint64_t unit(int piece_type, Player owner) {
+        return (owner == NO_ONE || piece_type > KING_ENUM) ? 0
+            : 1ULL << (BITS * (owner * (KING_ENUM + 1) + piece_type));
+    }
+
+    // Number of pieces of a kind in a signature
+    static int count(uint64_t signature, int piece_type, Player owner) {
+        uint64_t u = unit(piece_type, owner);
+        return u == 0 ? 0 : (int)((signature / u) & ((1 << BITS) - 1));
+    }
+
+    // Both kings alone
+    static constexpr uint64_t bare_kings() {
+        return unit(KING_ENUM, WHITE) + unit(KING_ENUM, BLACK);
+    }
+
+    // Return true if neither player can ever be checkmated: bare kings, or
+    // a king and a single knight or bishop against a bare king. Bishops on
+    // squares of one colour also can't mate, but a signature doesn't tell
+    // where they stand.
+    static bool insufficient(uint64_t signature) {
+        if (signature == bare_kings())
+            return true;
+        for (int owner = WHITE; owner <= BLACK; owner++) {
+            Player p = static_cast<Player>(owner);
+            if (signature == bare_kings() + unit(KNIGHT_ENUM, p) ||
+                signature == bare_kings() + unit(BISHOP_ENUM, p))
+                return true;
+        }
+        return false;
+    }
+
+};
+
+#endif // MATERIAL_H
@@ -0,0 +1,92 @@
+#ifndef MOVE_H
+#define MOVE_H
+
+#include <cstdint>
+
+// A move packed into 16 bits: the 1D board index it starts from (6 bits),
+// the index it ends on (6 bits) and 4 flag bits. Boards of up to 64 squares
+// fit. The same bits are used in memory, in the undo records and on disk.
+class Move {
+
+public:
+
+    // Flag bits
+    enum Flag {
+        CAPTURE = 1,   // takes the piece standing on to
+        PROMOTION = 2, // a pawn reaching the last row, always made a queen
+        GHOST = 4      // a Spooky Chess ghost landing: from is the square, to the random draws used
+    };
+
+    // The null move, used for "no move"
+    Move() : _bits(0) {}
+
+    Move(int from, int to, int flags = 0) :
+        _bits((uint16_t)((from & 63) | ((to & 63) << 6) | ((flags & 15) << 12))) {}
+
+    // Rebuild a move from its bits
+    static Move from_bits(uint16_t bits) {
+        Move m;
+        m._bits = bits;
+        return m;
+    }
+
+    int from() const { return _bits & 63; }
+    int to() const { return (_bits >> 6) & 63; }
+    int flags() const { return _bits >> 12; }
+    bool is(Flag f) const { return (flags() & f) != 0; }
+    uint16_t bits() const { return _bits; }
+
+    // Return true for the null move
+    bool is_null() const { return _bits == 0; }
+
+    // Moves are equal if they go from and to the same squares
+    bool operator==(const Move& other) const { return (_bits & 0xfff) == (other._bits & 0xfff); }
+    bool operator!=(const Move& other) const { return !(*this == other); }
+
+private:
+
+    uint16_t _bits;
+
+};
+
+
+// A list of moves with a fixed capacity, meant to live on the stack so
+// generating moves never allocates. No position has more than 218 moves.
+class MoveList {
+
+public:
+
+    static const int CAPACITY = 256;
+
+    MoveList() : _size(0) {}
+
+    void push(Move m) { _moves[_size++] = m; }
+    void clear() { _size = 0; }
+    int size() const { return _size; }
+    bool empty() const { return _size == 0; }
+
+    Move& operator[](int i) { return _moves[i]; }
+    const Move& operator[](int i) const { return _moves[i]; }
+
+    Move* begin() { return _moves; }
+    Move* end() { return _moves + _size; }
+    const Move* begin() const { return _moves; }
+    const Move* end() const { return _moves + _size; }
+
+    // Return true if the list holds a move with the same squares as m
+    bool contains(Move m) const {
+        for (int i = 0; i < _size; i++) {
+            if (_moves[i] == m)
+                return true;
+        }
+        return false;
+    }
+
+private:
+
+    Move _moves[CAPACITY];
+    int _size;
+
+};
+
+#endif // MOVE_H
@@ -0,0 +1,125 @@
+#include <vector>
+#include <mutex>
+#include "ChessGame.h"
+#include "Search.h"
+#include "ThreadPool.h"
+#include "Perft.h"
+
+using std::vector;
+
+// Count leaves with do_move/undo_move; the last ply is counted in bulk
+long Perft::count(ChessGame& game, int depth){
+  if(depth <= 0)
+    return 1;
+  MoveList moves;
+  game.legal_moves(moves);
+  if(depth == 1)
+    return moves.size();
+  long nodes = 0;
+  for(int i = 0; i < moves.size(); i++){
+    MoveRecord record;
+    game.do_move(moves[i], record);
+    nodes += count(game, depth - 1);
+    game.undo_move(record);
+  }
+  return nodes;
+}
+
+// Give every worker of the pool its own copy of the game
+static vector<ChessGame*> clone_for_workers(const ChessGame& game, const ThreadPool& pool){
+  vector<ChessGame*> clones;
+  for(int i = 0; i < pool.size(); i++)
+    clones.push_back(game.clone());
+  return clones;
+}
+
+static void delete_clones(vector<ChessGame*>& clones){
+  for(size_t i = 0; i < clones.size(); i++)
+    delete clones[i];
+  clones.clear();
+}
+
+vector<RootResult> Perft::divide(const ChessGame& game, int depth, ThreadPool& pool, int split_depth){
+  vector<RootResult> results;
+  ChessGame* root = game.clone(); //used to list the moves that become tasks
+  MoveList moves;
+  root->legal_moves(moves);
+  for(int i = 0; i < moves.size(); i++){
+    RootResult r = {moves[i], depth <= 1 ? 1 : 0, 0};
+    results.push_back(r);
+  }
+  if(depth <= 1){
+    delete root;
+    return results;
+  }
+
+  vector<ChessGame*> clones = clone_for_workers(game, pool);
+  vector<BoardState> after(moves.size()); //position after each root move, for the reply tasks
+  std::mutex lock; //guards the counts in results
+  for(int i = 0; i < moves.size(); i++){
+    if(split_depth < 2 || depth < 3){ //one task per root move
+      pool.submit([&, i](int worker){
+	  MoveRecord record;
+	  ChessGame& g = *clones[worker];
+	  g.do_move(moves[i], record);
+	  long nodes = count(g, depth - 1);
+	  g.undo_move(record);
+	  std::lock_guard<std::mutex> guard(lock);
+	  results[i].nodes += nodes;
+	});
+      continue;
+    }
+    //one task per reply to this root move
+    MoveRecord record;
+    root->do_move(moves[i], record);
+    MoveList replies;
+    root->legal_moves(replies);
+    root->export_state(after[i]);
+    root->undo_move(record);
+    for(int j = 0; j < replies.size(); j++){
+      Move reply = replies[j];
+      pool.submit([&, i, reply](int worker){
+	  MoveRecord second;
+	  ChessGame& g = *clones[worker];
+	  g.import_state(after[i]);
+	  g.do_move(reply, second);
+	  long nodes = count(g, depth - 2);
+	  std::lock_guard<std::mutex> guard(lock);
+	  results[i].nodes += nodes;
+	});
+    }
+  }
+  pool.wait();
+  delete_clones(clones);
+  delete root;
+  return results;
+}
+
+vector<RootResult> Perft::analyze(const ChessGame& game, int depth, ThreadPool& pool){
+  vector<RootResult> results;
+  ChessGame* root = game.clone();
+  MoveList moves;
+  root->legal_moves(moves);
+  delete root;
+  for(int i = 0; i < moves.size(); i++){
+    RootResult r = {moves[i], 0, 0};
+    results.push_back(r);
+  }
+
+  vector<ChessGame*> clones = clone_for_workers(game, pool);
+  for(int i = 0; i < moves.size(); i++){
+    pool.submit([&, i](int worker){
+	//a search restricted to this move scores it exactly as a full search would
+	Search* search = Search::for_game(*clones[worker]);
+	SearchLimits limits(depth);
+	limits.root_moves.push_back(moves[i]);
+	SearchResult r = search->run(limits);
+	delete search;
+	results[i].score = r.score; //each task writes its own entry
+	results[i].nodes = r.nodes;
+      });
+  }
+  pool.wait();
+  delete_clones(clones);
+  return results;
+}
@@ -0,0 +1,39 @@
+#ifndef PERFT_H
+#define PERFT_H
+
+#include <vector>
+#include "Move.h"
+#include "ChessGame.h"
+#include "ThreadPool.h"
+
+// Result for one root move: leaf count for perft, score for analysis
+struct RootResult {
+    Move move;
+    long nodes;
+    int score;
+};
+
+// Move generator validation (perft) and position analysis, either on the
+// calling thread or split into tasks on a ThreadPool. Each worker plays
+// its tasks on a private clone of the game, so the game passed in is never
+// touched by the workers.
+class Perft {
+
+public:
+
+    // Count the leaves of the legal move tree depth plies deep
+    static long count(ChessGame& game, int depth);
+
+    // Count the leaves below every root move in parallel. With split_depth 2
+    // every reply to a root move becomes its own task, which balances better
+    // when a few root moves own most of the tree.
+    static std::vector<RootResult> divide(const ChessGame& game, int depth,
+                                          ThreadPool& pool, int split_depth = 1);
+
+    // Search every root move depth plies deep in parallel and score it
+    // for the player to move
+    static std::vector<RootResult> analyze(const ChessGame& game, int depth, ThreadPool& pool);
+
+};
+
+#endif // PERFT_H
@@ -1,19 +1,33 @@
 #include <iostream>
 #include <exception>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <memory>
 #include "Prompts.h"
 #include "Game.h"
 #include "ChessGame.h"
 #include "SpookyChess.h"
 #include "HillChess.h"
+#include "ThreadPool.h"
+#include "Perft.h"
+#include "Variants.h"
+#include "Batch.h"
+#include "Journal.h"
+#include "Service.h"
+#include "SelfPlay.h"
+#include "Import.h"
+#include "PositionIndex.h"
+#include "ProofSearch.h"
+#include "Engine.h"
+#include "Spectator.h"
+#include "AnalysisCache.h"
 
 using std::cout;
 using std::cin;
 using std::string;
 
-// Game variant enumeration
-enum GameName {STANDARD_CHESS = 1, KING_OF_THE_HILL, SPOOKY_CHESS};
-
-
 // Ask user which game they want to play
 int collect_game_choice() {
     Prompts::game_choice();
@@ -38,40 +52,191 @@ string collect_filename() {
     return f;
 }
 
-int main() {
+// Print how to use the command-line tools
+int usage() {
+    std::cout << "Usage:\n"
+              << "  play [--journal FILE] [--engine white|black] [--clock MIN+SEC] [--no-ponder]\n"
+              << "       [--cache FILE] [--hint-ms N] [--index FILE] [--spectate FILE]\n"
+              << "                                                   interactive game, journaled to FILE, against\n"
+              << "                                                   the engine, on a clock of MIN minutes plus SEC\n"
+              << "                                                   seconds a move; hints use the analysis cache\n"
+              << "                                                   FILE and take at most N ms; the journaled\n"
+              << "                                                   game is added to the position index FILE;\n"
+              << "                                                   every turn is sent to FILE as spectator frames\n"
+              << "  play recover FILE                                continue a journaled game\n"
+              << "  play perft <game> <depth> [threads] [split] [file]  count move tree leaves\n"
+              << "  play analyze <game> <depth> [threads] [file]        score every move\n"
+              << "  play mate [--nodes N] [--memory MB] [--shortest] <game> <moves> [file]\n"
+              << "                                                   find a forced win within that many moves\n"
+              << "  play batch [--json] [--depth N] [--nodes N] [--threads N] [--cache FILE] [--out FILE] <file or dir>...\n"
+              << "                                                   analyse saved games\n"
+              << "  play serve [--clients N] [--games N] [NAME]      answer queries over shared memory\n"
+              << "  play loadtest [--clients N] [--games N] [--batch N] [--seconds N] [NAME]\n"
+              << "                                                   measure queries/sec against play serve\n"
+              << "  play selfplay [--games N] [--variant N] [--depth N] [--nodes N] [--threads N] [--random-plies N]\n"
+              << "                [--max-plies N] [--seed N] [--shard-size N] --out PATH\n"
+              << "                                                   write self-play training positions\n"
+              << "  play import [--threads N] [--shard-size N] [--index FILE] --out PATH <PGN or FEN file, or ->...\n"
+              << "                                                   turn game archives into training positions\n"
+              << "  play index add INDEX JOURNAL...                  add journaled games to a position index\n"
+              << "  play index lookup INDEX <game> [file]            how often a position occurred, and where\n"
+              << "  play index stats INDEX                           size of a position index\n"
+              << "  play fanout [--subscribers N] [--plies N] [--seed N] <game>\n"
+              << "                                                   measure sending turns to spectators\n"
+              << "where <game> is 1 (standard), 2 (king of the hill) or 3 (spooky)\n";
+    return 1;
+}
+
+// perft and analyze: work on every root move in parallel and report per move.
+// Other tools parse their own arguments.
+int run_tool(int argc, char* argv[]) {
+    string tool = argv[1];
+    if (tool == "batch")
+        return BatchAnalysis::main(std::vector<string>(argv + 2, argv + argc));
+    if (tool == "serve")
+        return ServiceServer::main(std::vector<string>(argv + 2, argv + argc));
+    if (tool == "loadtest")
+        return ServiceClient::load_test(std::vector<string>(argv + 2, argv + argc));
+    if (tool == "selfplay")
+        return SelfPlay::main(std::vector<string>(argv + 2, argv + argc));
+    if (tool == "import")
+        return GameImporter::main(std::vector<string>(argv + 2, argv + argc));
+    if (tool == "mate")
+        return ProofSearch::main(std::vector<string>(argv + 2, argv + argc));
+    if (tool == "index")
+        return PositionIndex::main(std::vector<string>(argv + 2, argv + argc));
+    if (tool == "fanout")
+        return SpectatorChannel::main(std::vector<string>(argv + 2, argv + argc));
+    bool perft = (tool == "perft");
+    if ((!perft && tool != "analyze") || argc < 4)
+        return usage();
+    int game_choice = std::atoi(argv[2]);
+    int depth = std::atoi(argv[3]);
+    int threads = argc > 4 ? std::atoi(argv[4]) : ThreadPool::hardware_threads();
+    int split = (perft && argc > 5) ? std::atoi(argv[5]) : 1;
+    int file_arg = perft ? 6 : 5;
+    string filename = argc > file_arg ? argv[file_arg] : "";
+
+    ChessGame* game = nullptr;
+    try {
+        game = create_game(game_choice, filename);
+    }
+    catch (std::exception& e) {
+        Prompts::load_failure();
+        return 1;
+    }
+    if (game == nullptr || depth < 1)
+        return usage();
+
+    ThreadPool pool(threads);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::vector<RootResult> results = perft ? Perft::divide(*game, depth, pool, split)
+                                            : Perft::analyze(*game, depth, pool);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    long total = 0;
+    for (size_t i = 0; i < results.size(); i++) {
+        std::cout << game->move_text(results[i].move) << ": ";
+        if (perft)
+            std::cout << results[i].nodes << "\n";
+        else
+            std::cout << results[i].score << " (" << results[i].nodes << " nodes)\n";
+        total += results[i].nodes;
+    }
+    std::cout << "nodes " << total << " time " << seconds << "s threads " << pool.size();
+    if (seconds > 0)
+        std::cout << " nps " << (long)(total / seconds);
+    std::cout << std::endl;
+    delete game;
+    return 0;
+}
+
+// Rebuild a game from its journal and keep playing it, still journaled
+int recover_game(const string& path) {
+    JournalTail tail;
+    ChessGame* g = Journal::recover(path, nullptr, &tail);
+    Journal journal;
+    if (g == nullptr || !journal.resume(path, tail.kept)) {
+        Prompts::load_failure();
+        delete g;
+        return 1;
+    }
+    g->attach_journal(&journal);
+    if (tail.dropped > 0)
+        Prompts::journal_tail(tail.dropped);
+    Prompts::recovered();
+    g->run();
+    delete g;
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+
+    // Pick a journaled game back up, or run a command-line tool instead of a game
+    if (argc == 3 && string(argv[1]) == "recover")
+        return recover_game(argv[2]);
+    if (argc > 1 && string(argv[1]).compare(0, 2, "--") != 0)
+        return run_tool(argc, argv);
+
+    // Journal moves to a file, play the engine, play on a clock
+    string journal_path;
+    Player engine_side = NO_ONE;
+    bool ponder = true;
+    long base = 0, increment = 0;
+    string cache_path;
+    string index_path;
+    string spectate_path;
+    int hint_latency = 0;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--journal" && has_value)
+            journal_path = argv[++i];
+        else if (arg == "--engine" && has_value) {
+            string side = argv[++i];
+            if (side != "white" && side != "black")
+                return usage();
+            engine_side = side == "white" ? WHITE : BLACK;
+        }
+        else if (arg == "--clock" && has_value) {
+            string clock = argv[++i];
+            size_t plus = clock.find('+');
+            base = (long)(std::atof(clock.substr(0, plus).c_str()) * 60000);
+            increment = plus == string::npos ? 0 : (long)(std::atof(clock.substr(plus + 1).c_str()) * 1000);
+            if (base <= 0)
+                return usage();
+        }
+        else if (arg == "--no-ponder")
+            ponder = false;
+        else if (arg == "--cache" && has_value)
+            cache_path = argv[++i];
+        else if (arg == "--index" && has_value)
+            index_path = argv[++i];
+        else if (arg == "--spectate" && has_value)
+            spectate_path = argv[++i];
+        else if (arg == "--hint-ms" && has_value)
+            hint_latency = std::atoi(argv[++i]);
+        else
+            return usage();
+    }
 
     // Determine which game to play, and how to begin it
     int game_choice = collect_game_choice();
     int new_or_load_choice = determine_new_or_load();
 
     // Set up the desired game
-    Game *g = nullptr;
+    ChessGame *g = nullptr;
+    string filename; //stays empty for a new game
     
   try{    
-    if (game_choice == STANDARD_CHESS && new_or_load_choice == 1) {  //new standard chess
-        g = new ChessGame();
-    } else if (game_choice == STANDARD_CHESS && new_or_load_choice == 2) { //load standard chess
-        string filename = collect_filename();
-	g = new ChessGame(filename, STANDARD_CHESS);
-    }
-
-
-    // You'll want to add additional alternatives here for chess game variants
-    else if(game_choice == SPOOKY_CHESS && new_or_load_choice == 1) {  //new standard chess
-        g = new SpookyChess();
-    } else if (game_choice == SPOOKY_CHESS && new_or_load_choice == 2) { //load standard chess
-        string filename = collect_filename();
-        g = new SpookyChess(filename, SPOOKY_CHESS);
-    }
-
-    else if(game_choice == KING_OF_THE_HILL && new_or_load_choice == 1) {  //new standard chess
-        g = new HillChess();
-    } else if (game_choice == KING_OF_THE_HILL && new_or_load_choice == 2) { //load standard chess
-        string filename = collect_filename();
-        g = new HillChess(filename, KING_OF_THE_HILL);
+    if (new_or_load_choice == 1) { //new game of the chosen variant
+        g = create_game(game_choice, "");
+    } else if (new_or_load_choice == 2 && game_choice >= STANDARD_CHESS && game_choice <= SPOOKY_CHESS) {
+        filename = collect_filename(); //load the chosen variant
+        g = create_game(game_choice, filename);
     }
     
-    else {
+    if (g == nullptr) {
       std::cout << "Invalid option(s) selected. Exiting the program. \n" << std::endl;
       return 1;
     }
@@ -85,10 +250,57 @@ int main() {
     return 1;
   }
 
+    // Every move goes to the journal, on top of the loaded file if any,
+    // and the journaled game to the position index once it is closed
+    std::unique_ptr<PositionIndexBuilder> index;
+    if (!index_path.empty())
+        index.reset(new PositionIndexBuilder(index_path));
+    Journal journal;
+    journal.attach_index(index.get());
+    if (!journal_path.empty()) {
+        if (!journal.start(journal_path, game_choice, filename)) {
+            Prompts::save_failure();
+            delete g;
+            return 1;
+        }
+        g->attach_journal(&journal);
+    }
+
+    if (base > 0)
+        g->clock().set(base, increment);
+    g->set_hint_latency(hint_latency);
+    AnalysisCache cache;
+    if (!cache_path.empty()) {
+        if (!cache.open(cache_path)) {
+            std::cerr << "Can't use " << cache_path << " as an analysis cache\n";
+            delete g;
+            return 1;
+        }
+        g->attach_cache(&cache);
+    }
+    std::unique_ptr<EnginePlayer> engine;
+    if (engine_side != NO_ONE) {
+        engine.reset(new EnginePlayer(*g, engine_side, ponder));
+        g->attach_engine(engine.get());
+    }
+    std::unique_ptr<SpectatorChannel> channel;
+    SpectatorStream stream;
+    if (!spectate_path.empty()) {
+        if (!stream.open(spectate_path)) {
+            std::cerr << "Can't write spectator frames to " << spectate_path << "\n";
+            delete g;
+            return 1;
+        }
+        channel.reset(new SpectatorChannel(*g));
+        channel->subscribe(&stream);
+        g->attach_spectators(channel.get());
+    }
+
   // Begin play of the selected game!
     g->run();
 
     // Nothing else to do here in main, so clean up
+    engine.reset();
     delete g;
 
     return 0;
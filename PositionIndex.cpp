@@ -0,0 +1,592 @@
+#include <string>
+#include <vector>
+#include <map>
+#include <iostream>
+#include <algorithm>
+#include <exception>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "ChessGame.h"
+#include "Variants.h"
+#include "Journal.h"
+#include "Prompts.h"
+#include "PositionIndex.h"
+
+using std::string;
+using std::vector;
+
+static const char MAGIC[4] = {'C', 'G', 'P', 'X'};
+static const uint32_t VERSION = 1;
+
+// Mixed into the keys of each variant, indexed by GameName
+static const uint64_t VARIANT_KEYS[] = {0, 0, 0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL};
+
+// Return the varint at p, moving p past it. Stops at end.
+static uint64_t read_varint(const uint8_t*& p, const uint8_t* end){
+  uint64_t value = 0;
+  for(int shift = 0; p < end && shift < 64; shift += 7){
+    uint8_t byte = *p++;
+    value |= (uint64_t)(byte & 0x7f) << shift;
+    if(!(byte & 0x80))
+      break;
+  }
+  return value;
+}
+
+// Decode the entry at p, whose key follows previous. Returns the end of the entry.
+static const uint8_t* read_entry(const uint8_t* p, const uint8_t* end, uint64_t previous, IndexEntry& entry){
+  entry.key = previous + read_varint(p, end);
+  entry.count = read_varint(p, end);
+  uint64_t references = read_varint(p, end);
+  entry.references = references < (uint64_t)INDEX_REFERENCES ? (int)references : INDEX_REFERENCES;
+  uint32_t game = 0;
+  for(int i = 0; i < entry.references; i++){
+    game += read_varint(p, end);
+    entry.games[i] = game;
+  }
+  return p;
+}
+
+uint64_t PositionIndex::key(const ChessGame& game, int variant){
+  if(variant < 0 || variant > SPOOKY_CHESS)
+    variant = 0;
+  return game.position_hash() ^ VARIANT_KEYS[variant];
+}
+
+// The file of run number run of the index at path, 0 being path itself
+static string run_path(const string& path, int run){
+  return run == 0 ? path : path + "." + std::to_string(run);
+}
+
+// A builder holds the lock exclusively while it merges, so a reader never
+// maps a run list that is being changed
+bool PositionIndex::open(const string& path){
+  int lock = ::open((path + ".lock").c_str(), O_RDONLY);
+  if(lock >= 0)
+    flock(lock, LOCK_SH);
+  bool ok = map_runs(path);
+  if(lock >= 0){
+    flock(lock, LOCK_UN);
+    ::close(lock);
+  }
+  return ok;
+}
+
+// Runs follow on from the games before them. One that doesn't was left by
+// a merge that stopped before removing it, and it and those after it are
+// ignored.
+bool PositionIndex::map_runs(const string& path){
+  close();
+  if(!map_run(path))
+    return false;
+  for(int run = 1; run < INDEX_MAX_RUNS; run++){
+    uint32_t before = games();
+    if(access(run_path(path, run).c_str(), F_OK) != 0 || !map_run(run_path(path, run)))
+      break;
+    if(_runs.back().header->first_game != before){
+      munmap(_runs.back().map, _runs.back().size);
+      _runs.pop_back();
+      break;
+    }
+  }
+  return true;
+}
+
+bool PositionIndex::map_run(const string& path){
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if(fd < 0)
+    return false;
+  struct stat info;
+  if(fstat(fd, &info) != 0 || info.st_size < (off_t)sizeof(IndexHeader)){
+    ::close(fd);
+    return false;
+  }
+  void* map = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd); //the mapping stays valid
+  if(map == MAP_FAILED)
+    return false;
+  Run run;
+  run.map = map;
+  run.size = info.st_size;
+
+  const IndexHeader* header = static_cast<const IndexHeader*>(map);
+  const char* bytes = static_cast<const char*>(map);
+  bool valid = memcmp(header->magic, MAGIC, sizeof MAGIC) == 0 && header->version == VERSION &&
+    header->size == run.size && header->directory + (uint64_t)header->blocks * sizeof(IndexBlock) <= header->game_table &&
+    header->game_table + (uint64_t)header->games * sizeof(IndexGame) <= header->source_table &&
+    header->source_table <= run.size;
+  if(!valid){
+    munmap(map, run.size);
+    return false;
+  }
+  run.blocks = reinterpret_cast<const IndexBlock*>(bytes + header->directory);
+  run.games = reinterpret_cast<const IndexGame*>(bytes + header->game_table);
+  const char* source = bytes + header->source_table;
+  for(uint32_t i = 0; i < header->sources; i++){
+    const char* end = static_cast<const char*>(memchr(source, 0, bytes + run.size - source));
+    if(end == nullptr){
+      munmap(map, run.size);
+      return false;
+    }
+    run.sources.push_back(source);
+    source = end + 1;
+  }
+  run.header = header;
+  _runs.push_back(run);
+  return true;
+}
+
+void PositionIndex::close(){
+  for(size_t r = 0; r < _runs.size(); r++)
+    munmap(_runs[r].map, _runs[r].size);
+  _runs.clear();
+}
+
+uint64_t PositionIndex::positions() const{
+  if(_runs.size() == 1)
+    return _runs[0].header->positions;
+  uint64_t count = 0;
+  for_each([&](const IndexEntry&){ count++; });
+  return count;
+}
+
+uint64_t PositionIndex::occurrences() const{
+  uint64_t count = 0;
+  for(size_t r = 0; r < _runs.size(); r++)
+    count += _runs[r].header->occurrences;
+  return count;
+}
+
+uint32_t PositionIndex::games() const{
+  uint32_t count = 0;
+  for(size_t r = 0; r < _runs.size(); r++)
+    count += _runs[r].header->games;
+  return count;
+}
+
+// The runs are in game id order, so their ids are kept in the order they come
+uint64_t PositionIndex::lookup(uint64_t key, vector<uint32_t>* games) const{
+  if(games != nullptr)
+    games->clear();
+  uint64_t count = 0;
+  for(size_t r = 0; r < _runs.size(); r++){
+    const Run& run = _runs[r];
+    if(run.header->blocks == 0)
+      continue;
+    //last block whose first key is not above key
+    const IndexBlock* block = std::upper_bound(run.blocks, run.blocks + run.header->blocks, key,
+      [](uint64_t k, const IndexBlock& b){ return k < b.first_key; });
+    if(block == run.blocks)
+      continue;
+    block--;
+    const uint8_t* bytes = static_cast<const uint8_t*>(run.map);
+    const uint8_t* p = bytes + block->offset;
+    const uint8_t* end = bytes + (block + 1 < run.blocks + run.header->blocks ? block[1].offset : run.header->directory);
+    uint64_t previous = block->first_key;
+    IndexEntry entry;
+    while(p < end){
+      p = read_entry(p, end, previous, entry);
+      previous = entry.key;
+      if(entry.key > key)
+	break;
+      if(entry.key == key){
+	count += entry.count;
+	for(int i = 0; games != nullptr && i < entry.references && games->size() < (size_t)INDEX_REFERENCES; i++)
+	  games->push_back(entry.games[i]);
+	break;
+      }
+    }
+  }
+  return count;
+}
+
+bool PositionIndex::game(uint32_t id, string& source, uint64_t& offset) const{
+  for(size_t r = 0; r < _runs.size(); r++){
+    const Run& run = _runs[r];
+    if(id < run.header->first_game || id - run.header->first_game >= run.header->games)
+      continue;
+    const IndexGame& game = run.games[id - run.header->first_game];
+    if(game.source >= run.sources.size())
+      return false;
+    source = run.sources[game.source];
+    offset = game.offset;
+    return true;
+  }
+  return false;
+}
+
+// Reads the entries of one run in key order
+struct RunCursor {
+  const uint8_t* bytes;
+  const IndexHeader* header;
+  const IndexBlock* blocks;
+  uint32_t block;       // the next block to start
+  const uint8_t* p;
+  const uint8_t* end;
+  uint64_t previous;
+  IndexEntry entry;     // the current entry, while valid
+  bool valid;
+
+  bool advance(){
+    while(p >= end){
+      if(block >= header->blocks)
+	return valid = false;
+      p = bytes + blocks[block].offset;
+      end = bytes + (block + 1 < header->blocks ? blocks[block + 1].offset : header->directory);
+      previous = blocks[block].first_key;
+      block++;
+    }
+    p = read_entry(p, end, previous, entry);
+    previous = entry.key;
+    return valid = true;
+  }
+};
+
+// A merge of the runs: there are few of them, so the smallest key is found
+// by looking at each
+void PositionIndex::for_each(const std::function<void(const IndexEntry&)>& visit) const{
+  vector<RunCursor> cursors(_runs.size());
+  for(size_t r = 0; r < _runs.size(); r++){
+    RunCursor& c = cursors[r];
+    c.bytes = static_cast<const uint8_t*>(_runs[r].map);
+    c.header = _runs[r].header;
+    c.blocks = _runs[r].blocks;
+    c.block = 0;
+    c.p = c.end = nullptr;
+    c.previous = 0;
+    c.advance();
+  }
+  while(true){
+    RunCursor* first = nullptr;
+    for(size_t r = 0; r < cursors.size(); r++){
+      if(cursors[r].valid && (first == nullptr || cursors[r].entry.key < first->entry.key))
+	first = &cursors[r];
+    }
+    if(first == nullptr)
+      return;
+    IndexEntry e = first->entry;
+    first->advance();
+    for(size_t r = 0; r < cursors.size(); r++){
+      RunCursor& c = cursors[r];
+      if(!c.valid || c.entry.key != e.key)
+	continue;
+      e.count += c.entry.count;
+      for(int i = 0; i < c.entry.references && e.references < INDEX_REFERENCES; i++)
+	e.games[e.references++] = c.entry.games[i];
+      c.advance();
+    }
+    visit(e);
+  }
+}
+
+
+// Buffered writes of a new index file
+class IndexOutput {
+
+public:
+
+  explicit IndexOutput(int fd) : _fd(fd), _written(0), _failed(false) {}
+
+  uint64_t offset() const { return _written + _buffer.size(); }
+
+  bool failed() const { return _failed; }
+
+  void bytes(const void* data, size_t size){
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    _buffer.insert(_buffer.end(), p, p + size);
+    if(_buffer.size() >= (1 << 20))
+      flush();
+  }
+
+  void varint(uint64_t value){
+    while(value >= 0x80){
+      _buffer.push_back((uint8_t)(value | 0x80));
+      value >>= 7;
+    }
+    _buffer.push_back((uint8_t)value);
+  }
+
+  void entry(uint64_t previous, const IndexEntry& e){
+    varint(e.key - previous);
+    varint(e.count);
+    varint(e.references);
+    uint32_t game = 0;
+    for(int i = 0; i < e.references; i++){
+      varint(e.games[i] - game);
+      game = e.games[i];
+    }
+  }
+
+  void flush(){
+    if(!_buffer.empty() && write(_fd, _buffer.data(), _buffer.size()) != (ssize_t)_buffer.size())
+      _failed = true;
+    _written += _buffer.size();
+    _buffer.clear();
+  }
+
+private:
+
+  int _fd;
+  uint64_t _written;
+  bool _failed;
+  vector<uint8_t> _buffer;
+
+};
+
+
+void PositionIndexBuilder::add_game(const string& source, uint64_t offset, const uint64_t* keys, int count){
+  std::lock_guard<std::mutex> guard(_lock);
+  std::map<string, uint32_t>::iterator it = _source_ids.find(source);
+  if(it == _source_ids.end()){
+    it = _source_ids.insert(std::make_pair(source, (uint32_t)_sources.size())).first;
+    _sources.push_back(source);
+  }
+  IndexGame game = {it->second, 0, offset};
+  uint32_t id = _games.size();
+  _games.push_back(game);
+  for(int i = 0; i < count; i++)
+    _occurrences.push_back(std::make_pair(keys[i], id));
+  if(_occurrences.size() >= _limit && !merge())
+    _failed = true;
+}
+
+bool PositionIndexBuilder::add_journal(const string& path){
+  vector<uint64_t> keys;
+  int game = Journal::game_of(path);
+  ChessGame* g = Journal::recover(path, &keys);
+  if(g == nullptr)
+    return false;
+  delete g;
+  for(size_t k = 0; k < keys.size(); k++)
+    keys[k] ^= VARIANT_KEYS[game];
+  add_game(path, 0, keys.data(), keys.size());
+  return true;
+}
+
+bool PositionIndexBuilder::flush(){
+  std::lock_guard<std::mutex> guard(_lock);
+  if(!_games.empty() && !merge())
+    _failed = true;
+  return !_failed;
+}
+
+bool PositionIndexBuilder::merge(){
+  string lock_path = _path + ".lock";
+  int lock = open(lock_path.c_str(), O_WRONLY | O_CREAT, 0644);
+  if(lock < 0)
+    return false;
+  flock(lock, LOCK_EX);
+
+  PositionIndex old;
+  bool exists = access(_path.c_str(), F_OK) == 0;
+  if(exists && !old.map_runs(_path)){ //don't replace something that isn't an index
+    flock(lock, LOCK_UN);
+    close(lock);
+    return false;
+  }
+  //a new run, or with no room for one, everything in one file
+  bool whole = old.runs() == 0 || old.runs() >= INDEX_MAX_RUNS;
+  int target = whole ? 0 : old.runs();
+
+  //sources and games: the old ones keep their ids, new ones follow. A run
+  //lists only its own.
+  vector<string> sources;
+  std::map<string, uint32_t> source_ids;
+  for(uint32_t g = 0; whole && g < old.games(); g++){
+    string source;
+    uint64_t offset;
+    old.game(g, source, offset);
+    if(source_ids.insert(std::make_pair(source, (uint32_t)sources.size())).second)
+      sources.push_back(source);
+  }
+  vector<uint32_t> local_source(_sources.size());
+  for(size_t s = 0; s < _sources.size(); s++){
+    std::pair<std::map<string, uint32_t>::iterator, bool> added =
+      source_ids.insert(std::make_pair(_sources[s], (uint32_t)sources.size()));
+    if(added.second)
+      sources.push_back(_sources[s]);
+    local_source[s] = added.first->second;
+  }
+  uint32_t first_new = old.games();
+  std::sort(_occurrences.begin(), _occurrences.end());
+
+  string final_path = run_path(_path, target);
+  string temp_path = final_path + ".tmp";
+  int fd = open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if(fd < 0){
+    flock(lock, LOCK_UN);
+    close(lock);
+    return false;
+  }
+  IndexOutput out(fd);
+  IndexHeader header;
+  memset(&header, 0, sizeof header);
+  memcpy(header.magic, MAGIC, sizeof MAGIC);
+  header.version = VERSION;
+  header.first_game = whole ? 0 : first_new;
+  out.bytes(&header, sizeof header); //filled in at the end
+
+  vector<IndexBlock> directory;
+  int in_block = INDEX_BLOCK_ENTRIES;
+  uint64_t previous = 0;
+  auto emit = [&](const IndexEntry& e){
+    if(in_block == INDEX_BLOCK_ENTRIES){
+      IndexBlock block = {e.key, out.offset()};
+      directory.push_back(block);
+      previous = e.key;
+      in_block = 0;
+    }
+    out.entry(previous, e);
+    previous = e.key;
+    in_block++;
+    header.positions++;
+    header.occurrences += e.count;
+  };
+
+  //the new occurrences, grouped by key, merged into the old entries in key order
+  size_t next = 0;
+  auto add_new = [&](IndexEntry& e, uint64_t key){
+    for(; next < _occurrences.size() && _occurrences[next].first == key; next++){
+      uint32_t game = first_new + _occurrences[next].second;
+      e.count++;
+      if(e.references < INDEX_REFERENCES && (e.references == 0 || e.games[e.references - 1] != game))
+	e.games[e.references++] = game;
+    }
+  };
+  if(whole)
+    old.for_each([&](const IndexEntry& stored){
+      while(next < _occurrences.size() && _occurrences[next].first < stored.key){
+	IndexEntry e;
+	e.key = _occurrences[next].first;
+	e.count = 0;
+	e.references = 0;
+	add_new(e, e.key);
+	emit(e);
+      }
+      IndexEntry e = stored;
+      add_new(e, e.key);
+      emit(e);
+    });
+  while(next < _occurrences.size()){
+    IndexEntry e;
+    e.key = _occurrences[next].first;
+    e.count = 0;
+    e.references = 0;
+    add_new(e, e.key);
+    emit(e);
+  }
+
+  header.blocks = directory.size();
+  header.directory = out.offset();
+  if(!directory.empty())
+    out.bytes(directory.data(), directory.size() * sizeof(IndexBlock));
+  header.game_table = out.offset();
+  for(uint32_t g = 0; whole && g < old.games(); g++){
+    string source;
+    IndexGame game = {0, 0, 0};
+    old.game(g, source, game.offset);
+    game.source = source_ids[source];
+    out.bytes(&game, sizeof game);
+  }
+  for(size_t g = 0; g < _games.size(); g++){
+    IndexGame game = _games[g];
+    game.source = local_source[game.source];
+    out.bytes(&game, sizeof game);
+  }
+  header.games = (whole ? old.games() : 0) + _games.size();
+  header.source_table = out.offset();
+  for(size_t s = 0; s < sources.size(); s++)
+    out.bytes(sources[s].c_str(), sources[s].size() + 1);
+  header.sources = sources.size();
+  header.size = out.offset();
+  out.flush();
+
+  bool ok = !out.failed() && pwrite(fd, &header, sizeof header, 0) == (ssize_t)sizeof header && fsync(fd) == 0;
+  close(fd);
+  old.close();
+  ok = ok && rename(temp_path.c_str(), final_path.c_str()) == 0;
+  if(!ok)
+    unlink(temp_path.c_str());
+  for(int run = target + 1; ok && run < INDEX_MAX_RUNS; run++)
+    unlink(run_path(_path, run).c_str()); //folded into this file, or left by an unfinished merge
+  flock(lock, LOCK_UN);
+  close(lock);
+
+  _sources.clear();
+  _source_ids.clear();
+  _games.clear();
+  _occurrences.clear();
+  return ok;
+}
+
+
+// play index add: every position of each journaled game
+static int add_journals(const string& path, const vector<string>& journals){
+  PositionIndexBuilder builder(path);
+  int failures = 0;
+  for(size_t i = 0; i < journals.size(); i++){
+    if(!builder.add_journal(journals[i])){
+      std::cerr << "Skipping " << journals[i] << ": not a journal\n";
+      failures++;
+    }
+  }
+  if(!builder.flush()){
+    std::cerr << "Can't update " << path << "\n";
+    return 1;
+  }
+  return failures > 0 ? 1 : 0;
+}
+
+int PositionIndex::main(const vector<string>& args){
+  if(args.size() >= 3 && args[0] == "add")
+    return add_journals(args[1], vector<string>(args.begin() + 2, args.end()));
+
+  bool lookup = args.size() >= 3 && args.size() <= 4 && args[0] == "lookup";
+  bool stats = args.size() == 2 && args[0] == "stats";
+  if(!lookup && !stats){
+    std::cerr << "Usage: play index add INDEX JOURNAL...\n"
+	      << "       play index lookup INDEX <game> [file]\n"
+	      << "       play index stats INDEX\n";
+    return 1;
+  }
+  PositionIndex index;
+  if(!index.open(args[1])){
+    std::cerr << "Can't read " << args[1] << " as a position index\n";
+    return 1;
+  }
+  if(stats){
+    std::cout << "positions " << index.positions() << " occurrences " << index.occurrences()
+	      << " games " << index.games() << std::endl;
+    return 0;
+  }
+
+  int variant = std::atoi(args[2].c_str());
+  ChessGame* game = nullptr;
+  try {
+    game = create_game(variant, args.size() > 3 ? args[3] : "");
+  }
+  catch(std::exception& e){
+    Prompts::load_failure();
+    return 1;
+  }
+  if(game == nullptr){
+    std::cerr << "Unknown game " << args[2] << "\n";
+    return 1;
+  }
+  vector<uint32_t> games;
+  uint64_t count = index.lookup(key(*game, variant), &games);
+  delete game;
+  std::cout << "occurrences " << count << std::endl;
+  for(size_t i = 0; i < games.size(); i++){
+    string source;
+    uint64_t offset;
+    if(index.game(games[i], source, offset))
+      std::cout << source << " " << offset << std::endl;
+  }
+  return 0;
+}
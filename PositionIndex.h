@@ -0,0 +1,199 @@
+#ifndef POSITION_INDEX_H
+#define POSITION_INDEX_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <functional>
+#include <cstdint>
+
+class ChessGame;
+
+// Positions per compressed block, and game ids kept per position
+const int INDEX_BLOCK_ENTRIES = 128;
+const int INDEX_REFERENCES = 16;
+
+// Files an index may be split into before a merge folds them back into one
+const int INDEX_MAX_RUNS = 8;
+
+// Layout of an index file, all little-endian:
+//   IndexHeader
+//   blocks      up to INDEX_BLOCK_ENTRIES positions each, in key order. Per
+//               position, as varints: the key's difference from the one
+//               before (the first key of a block is in the directory), the
+//               number of occurrences, the number of game ids kept, and the
+//               ids, each as its difference from the one before
+//   directory   an IndexBlock per block
+//   games       an IndexGame per game id
+//   sources     the games' file names, each ending with a 0 byte
+// An index is the file at its path and possibly runs next to it, named
+// path.1, path.2 and so on, each laid out the same way and holding the
+// games added since the one before.
+struct IndexHeader {
+    char magic[4];          // "CGPX"
+    uint32_t version;
+    uint64_t positions;     // unique positions
+    uint64_t occurrences;   // positions counted with repeats
+    uint32_t blocks;
+    uint32_t games;
+    uint32_t sources;
+    uint32_t first_game;    // id of the file's first game: 0, or the games before a run
+    uint64_t directory;     // file offsets of the sections
+    uint64_t game_table;
+    uint64_t source_table;
+    uint64_t size;          // of the whole file
+};
+
+struct IndexBlock {
+    uint64_t first_key;
+    uint64_t offset;        // in the file
+};
+
+struct IndexGame {
+    uint32_t source;        // index into the sources
+    uint32_t reserved;
+    uint64_t offset;        // byte offset of the game in its source, 0 for a journal
+};
+
+// One position as stored
+struct IndexEntry {
+    uint64_t key;
+    uint64_t count;
+    int references;         // game ids kept
+    uint32_t games[INDEX_REFERENCES]; // the lowest ids of the games it occurred in
+};
+
+
+// Read side of the position index: every position reached in the indexed
+// games, keyed by PositionIndex::key, with how often it occurred and the
+// first games it occurred in. The files are mapped; a lookup is a binary
+// search of each file's directory and a walk of one compressed block.
+class PositionIndex {
+
+public:
+
+    PositionIndex() {}
+
+    // Unmaps the file
+    ~PositionIndex() { close(); }
+
+    PositionIndex(const PositionIndex&) = delete;
+    PositionIndex& operator=(const PositionIndex&) = delete;
+
+    // Map the index at path and its runs. Returns false if it can't be read
+    // or is not an index.
+    bool open(const std::string& path);
+
+    void close();
+
+    bool is_open() const { return !_runs.empty(); }
+
+    // Number of files mapped: 1, plus the runs
+    int runs() const { return _runs.size(); }
+
+    // Unique positions. A position in several runs is counted once, which
+    // takes a walk of them all.
+    uint64_t positions() const;
+
+    uint64_t occurrences() const;
+    uint32_t games() const;
+
+    // Return how often the position with key occurred, 0 if never. Fills
+    // games, if given, with the ids of the first games it occurred in.
+    uint64_t lookup(uint64_t key, std::vector<uint32_t>* games = nullptr) const;
+
+    // Find where game id came from. Returns false if there is no such game.
+    bool game(uint32_t id, std::string& source, uint64_t& offset) const;
+
+    // Call visit with every position, in key order, the runs merged
+    void for_each(const std::function<void(const IndexEntry&)>& visit) const;
+
+    // Key of the game's current position. Each variant mixes in its own
+    // constant, as the engine's cache keys do.
+    static uint64_t key(const ChessGame& game, int variant);
+
+    // Command-line entry: play index add INDEX JOURNAL...
+    //                     play index lookup INDEX <game> [file]
+    //                     play index stats INDEX
+    static int main(const std::vector<std::string>& args);
+
+private:
+
+    // One mapped file
+    struct Run {
+        void* map;
+        size_t size;
+        const IndexHeader* header;
+        const IndexBlock* blocks;
+        const IndexGame* games;
+        std::vector<const char*> sources;
+    };
+
+    std::vector<Run> _runs;
+
+    friend class PositionIndexBuilder;
+
+    // open without the lock, for a builder that holds it
+    bool map_runs(const std::string& path);
+
+    // Map one file. Returns false if it is not an index.
+    bool map_run(const std::string& path);
+
+};
+
+
+// Write side: collects the positions of new games and merges them into the
+// index. A merge writes them, sorted, as a new run, whose cost depends only
+// on the new games. Once there are INDEX_MAX_RUNS files, the merge instead
+// reads them all in key order and writes a single file that replaces them.
+// Files are written next to their final name and then renamed, so readers
+// that have the old ones mapped are not disturbed. A lock file keeps two
+// builders from merging at once, and readers from opening half a merge.
+// add_game and add_journal may be called from several threads.
+class PositionIndexBuilder {
+
+public:
+
+    // Positions collected before they are merged on their own
+    static const size_t DEFAULT_LIMIT = 1 << 23;
+
+    explicit PositionIndexBuilder(const std::string& path, size_t limit = DEFAULT_LIMIT) :
+        _path(path), _limit(limit), _failed(false) {}
+
+    // Merges what is left
+    ~PositionIndexBuilder() { flush(); }
+
+    PositionIndexBuilder(const PositionIndexBuilder&) = delete;
+    PositionIndexBuilder& operator=(const PositionIndexBuilder&) = delete;
+
+    // Add a game found at offset in source, that reached the count
+    // positions with the given keys
+    void add_game(const std::string& source, uint64_t offset, const uint64_t* keys, int count);
+
+    // Add every position of the game journaled at path. Returns false if it
+    // is not a journal.
+    bool add_journal(const std::string& path);
+
+    // Merge everything collected into the file. Returns false if this or an
+    // earlier merge failed.
+    bool flush();
+
+private:
+
+    std::string _path;
+    size_t _limit;
+    bool _failed;
+
+    std::mutex _lock;                          // guards everything below
+    std::vector<std::string> _sources;         // new sources, by local id
+    std::map<std::string, uint32_t> _source_ids;
+    std::vector<IndexGame> _games;             // new games, by local id
+    std::vector<std::pair<uint64_t, uint32_t> > _occurrences; // key and local game id
+
+    // flush with _lock held
+    bool merge();
+
+};
+
+#endif // POSITION_INDEX_H
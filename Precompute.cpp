@@ -0,0 +1,50 @@
+#include <vector>
+#include <thread>
+#include "ChessGame.h"
+#include "Precompute.h"
+
+Precompute::Precompute(const ChessGame& game) : _worker(game.clone()), _key(0), _started(false) {}
+
+Precompute::~Precompute(){
+  if(_thread.joinable())
+    _thread.join();
+  delete _worker;
+}
+
+void Precompute::start(const ChessGame& game){
+  if(_started && _key == game.reply_key())
+    return;
+  if(_thread.joinable())
+    _thread.join();
+  game.export_state(_state);
+  _key = game.reply_key();
+  _started = true;
+  _thread = std::thread(&Precompute::work, this);
+}
+
+// Play each legal move on the copy and note what try_move would find
+void Precompute::work(){
+  _replies.clear();
+  _worker->import_state(_state);
+  MoveList moves;
+  _worker->legal_moves(moves);
+  for(int i = 0; i < moves.size(); i++){
+    MoveRecord record;
+    _worker->do_move(moves[i], record);
+    PrecomputedReply reply = {moves[i], _worker->outcome(), _worker->check(_worker->opponent())};
+    _replies.push_back(reply);
+    _worker->undo_move(record);
+  }
+}
+
+const PrecomputedReply* Precompute::find(uint64_t key, Move m){
+  if(_thread.joinable())
+    _thread.join();
+  if(!_started || key != _key)
+    return nullptr;
+  for(size_t i = 0; i < _replies.size(); i++){
+    if(_replies[i].move == m)
+      return &_replies[i];
+  }
+  return nullptr;
+}
@@ -0,0 +1,59 @@
+#ifndef PRECOMPUTE_H
+#define PRECOMPUTE_H
+
+#include <vector>
+#include <thread>
+#include <cstdint>
+#include "Move.h"
+#include "BoardState.h"
+
+class ChessGame;
+
+// What a legal move leads to, as try_move reports it
+struct PrecomputedReply {
+    Move move;
+    int outcome;  // outcome() once the move is played
+    bool check;   // whether the move gives check
+};
+
+// Works out every legal move of a position, and the outcome and check
+// each one leads to, on a background thread. ChessGame::run starts it
+// before waiting for the player's input, so by the time a move has been
+// typed the mate and check tests try_move needs are already done.
+class Precompute {
+
+public:
+
+    // Work is done on a copy of game, which must not be deleted first
+    explicit Precompute(const ChessGame& game);
+
+    // Waits for any work in progress
+    ~Precompute();
+
+    Precompute(const Precompute&) = delete;
+    Precompute& operator=(const Precompute&) = delete;
+
+    // Start on the game's current position, unless it is the one last done
+    // with the same halfmove clock and repetitions
+    void start(const ChessGame& game);
+
+    // Wait for the work to finish, then return the reply for move m in the
+    // position whose reply_key() is key, or nullptr if m is not legal there
+    // or the position was not worked out
+    const PrecomputedReply* find(uint64_t key, Move m);
+
+private:
+
+    ChessGame* _worker;  // the copy the thread plays moves on
+    std::thread _thread;
+    BoardState _state;   // position handed to the thread
+    uint64_t _key;       // reply_key() of that position
+    bool _started;
+    std::vector<PrecomputedReply> _replies;
+
+    // Runs on the thread
+    void work();
+
+};
+
+#endif // PRECOMPUTE_H
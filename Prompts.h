@@ -52,6 +52,20 @@ public:
       std::cout << "The loaded game doesn't match the selected game type\n";
     }
 
+    // The end of a journal was cut off or didn't replay, and is dropped
+    static void journal_tail(long bytes) {
+        std::cout << "The last " << bytes << " byte(s) of the journal were incomplete and are dropped.\n";
+    }
+
+    // Journaling stopped, since a write failed
+    static void journal_failure() {
+        std::cout << "Failed to write the journal; moves are no longer journaled\n";
+    }
+
+    static void recovered() {
+        std::cout << "Game recovered from journal. Press Enter to continue.\n";
+    }
+
     static void save_success(){
       std::cout << "Game saved successfully\n";
     }
@@ -86,6 +100,18 @@ public:
         std::cout << "Stalemate!\n";
     }
 
+    static void threefold_repetition() {
+        std::cout << "Draw by threefold repetition!\n";
+    }
+
+    static void fifty_moves() {
+        std::cout << "Draw by the fifty-move rule!\n";
+    }
+
+    static void insufficient_material() {
+        std::cout << "Draw: neither player can checkmate!\n";
+    }
+
     static void parse_error() {
         std::cout << "Error: couldn't parse your move.\n";
     }
@@ -122,6 +148,47 @@ public:
         std::cout << get_player_name(pl) << " wins on turn " << turn << ".\n";
     }
 
+    static void out_of_time(Player pl) {
+        std::cout << get_player_name(pl) << " is out of time!\n";
+    }
+
+    static void hint(const std::string& move, int depth) {
+        std::cout << "Hint: " << move << " (searched " << depth << " plies)\n";
+    }
+
+    static void taken_back(int plies) {
+        std::cout << (plies == 1 ? "The last move was" : "The last " + std::to_string(plies) + " moves were") << " taken back.\n";
+    }
+
+    static void no_takeback() {
+        std::cout << "Error: there is no move to take back.\n";
+    }
+
+    static void review(int ply, int plies) {
+        std::cout << "Position after move " << ply << " of " << plies << ":\n";
+    }
+
+    static void no_review(int plies) {
+        std::cout << "Error: the game has moves 0 to " << plies << " to review.\n";
+    }
+
+    static void engine_move(Player pl, const std::string& move) {
+        std::cout << get_player_name(pl) << " (engine) plays " << move << ".\n";
+    }
+
+    // Time left on each player's clock, as minutes:seconds
+    static void clock(long white_ms, long black_ms) {
+        std::cout << "Clock  White " << clock_text(white_ms) << "  Black " << clock_text(black_ms) << std::endl;
+    }
+
+    static std::string clock_text(long ms) {
+        long seconds = ms > 0 ? ms / 1000 : 0;
+        std::string text = std::to_string(seconds / 60) + ":";
+        if (seconds % 60 < 10)
+            text += "0";
+        return text + std::to_string(seconds % 60);
+    }
+
     static void game_over() {
         std::cout << "Game over. Goodbye!\n";
     }
@@ -0,0 +1,260 @@
+#include <string>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <cstdlib>
+#include "ChessGame.h"
+#include "HillChess.h"
+#include "SpookyChess.h"
+#include "Variants.h"
+#include "Prompts.h"
+#include "ProofSearch.h"
+
+using std::string;
+using std::vector;
+
+// Proof and disproof numbers of a settled node; sums stop here
+static const uint32_t INFINITE_NUMBER = 1u << 30;
+
+static uint32_t add(uint32_t a, uint32_t b){
+  return a + b >= INFINITE_NUMBER ? INFINITE_NUMBER : a + b;
+}
+
+ProofSearch::ProofSearch(ChessGame& game) :
+  _game(game), _hill(dynamic_cast<HillChess*>(&game)),
+  _solvable(dynamic_cast<SpookyChess*>(&game) == nullptr),
+  _capacity(0), _visited(0), _node_limit(0), _max_ply(0) {}
+
+ProofResult ProofSearch::solve(const ProofLimits& limits){
+  ProofResult result;
+  _visited = 0;
+  _node_limit = limits.nodes;
+  _capacity = limits.memory / sizeof(Node);
+  if(!_solvable || _capacity < 1)
+    return result;
+  if(_game.outcome() != 0){
+    result.status = DISPROVEN;
+    return result;
+  }
+  _nodes.reserve(_capacity);
+
+  //with shortest, a proof for n moves is only looked for once none for fewer exists
+  int n = limits.shortest ? 1 : limits.moves;
+  result.status = DISPROVEN;
+  for(; n <= limits.moves && result.status == DISPROVEN; n++){
+    _max_ply = 2 * n - 1;
+    result.status = prove();
+  }
+  if(result.status == PROVEN){
+    result.moves = (proof_length(0, true) + 1) / 2;
+    proof_line(0, true, result.line);
+  }
+  result.nodes = _visited;
+  _nodes.clear();
+  _nodes.shrink_to_fit();
+  return result;
+}
+
+ProofStatus ProofSearch::prove(){
+  _nodes.clear();
+  Node root = {1, 1, -1, 0, Move()};
+  _nodes.push_back(root);
+
+  vector<int> path;
+  vector<MoveRecord> records;
+  while(_nodes[0].proof != 0 && _nodes[0].disproof != 0){
+    if(_node_limit > 0 && _visited >= _node_limit)
+      return UNKNOWN;
+
+    //down to the most proving leaf: the cheapest child to prove below an
+    //OR node, the cheapest to disprove below an AND node
+    int node = 0;
+    path.clear();
+    records.clear();
+    while(_nodes[node].first_child >= 0){
+      bool or_node = path.size() % 2 == 0;
+      int best = _nodes[node].first_child;
+      for(int c = best + 1; c < _nodes[node].first_child + _nodes[node].children; c++){
+	if(or_node ? _nodes[c].proof < _nodes[best].proof : _nodes[c].disproof < _nodes[best].disproof)
+	  best = c;
+      }
+      path.push_back(node);
+      records.push_back(MoveRecord());
+      _game.do_move(_nodes[best].move, records.back());
+      node = best;
+    }
+
+    bool expanded = expand(node, path.size());
+
+    //back up the numbers, taking the moves back on the way
+    for(size_t i = path.size(); i-- > 0;){
+      _game.undo_move(records[i]);
+      update(_nodes[path[i]], i % 2 == 0);
+    }
+    if(!expanded)
+      return UNKNOWN;
+  }
+  return _nodes[0].proof == 0 ? PROVEN : DISPROVEN;
+}
+
+bool ProofSearch::expand(int node, int ply){
+  MoveList moves;
+  _game.legal_moves(moves);
+  if(_nodes.size() + moves.size() > _capacity)
+    return false;
+  int first = _nodes.size();
+  for(int i = 0; i < moves.size(); i++){
+    Node child = {1, 1, -1, 0, moves[i]};
+    MoveRecord record;
+    _game.do_move(moves[i], record);
+    evaluate(child, ply + 1);
+    _game.undo_move(record);
+    _nodes.push_back(child);
+  }
+  _nodes[node].first_child = first;
+  _nodes[node].children = moves.size();
+  update(_nodes[node], ply % 2 == 0);
+  return true;
+}
+
+void ProofSearch::evaluate(Node& node, int ply){
+  _visited++;
+  bool attacker_moved = ply % 2 == 1;
+  uint32_t won = attacker_moved ? 0 : INFINITE_NUMBER; //proof number if the mover has won
+  if(_hill != nullptr && _hill->hill_winner() != NO_ONE){ //only the mover can have just got there
+    node.proof = won;
+    node.disproof = INFINITE_NUMBER - won;
+    return;
+  }
+  bool check = _game.check(_game.opponent());
+  if(_game.repetitions() > 0 || _game.fifty_moves() || _game.insufficient_material() || (ply >= _max_ply && !check)){
+    node.proof = INFINITE_NUMBER;
+    node.disproof = 0;
+    return;
+  }
+  MoveList replies;
+  _game.legal_moves(replies);
+  if(replies.empty()){ //checkmate or stalemate
+    node.proof = check ? won : INFINITE_NUMBER;
+    node.disproof = INFINITE_NUMBER - node.proof;
+    return;
+  }
+  if(ply >= _max_ply){ //out of moves
+    node.proof = INFINITE_NUMBER;
+    node.disproof = 0;
+    return;
+  }
+  //the fewer the defences, the easier the proof
+  node.proof = attacker_moved ? replies.size() : 1;
+  node.disproof = attacker_moved ? 1 : replies.size();
+}
+
+void ProofSearch::update(Node& node, bool or_node){
+  if(node.children == 0){ //no legal move at the root
+    node.proof = INFINITE_NUMBER;
+    node.disproof = 0;
+    return;
+  }
+  uint32_t least = INFINITE_NUMBER, sum = 0;
+  for(int c = node.first_child; c < node.first_child + node.children; c++){
+    const Node& child = _nodes[c];
+    least = std::min(least, or_node ? child.proof : child.disproof);
+    sum = add(sum, or_node ? child.disproof : child.proof);
+  }
+  node.proof = or_node ? least : sum;
+  node.disproof = or_node ? sum : least;
+}
+
+int ProofSearch::proof_length(int node, bool or_node) const{
+  const Node& n = _nodes[node];
+  if(n.first_child < 0)
+    return 0;
+  int length = or_node ? MAX_PROOF_PLIES : 0;
+  for(int c = n.first_child; c < n.first_child + n.children; c++){
+    if(_nodes[c].proof != 0)
+      continue;
+    int child = 1 + proof_length(c, !or_node);
+    length = or_node ? std::min(length, child) : std::max(length, child);
+  }
+  return length;
+}
+
+// The quickest win, against the defence that holds out longest
+void ProofSearch::proof_line(int node, bool or_node, vector<Move>& line) const{
+  const Node& n = _nodes[node];
+  int best = -1, best_length = 0;
+  for(int c = n.first_child; n.first_child >= 0 && c < n.first_child + n.children; c++){
+    if(_nodes[c].proof != 0)
+      continue;
+    int length = proof_length(c, !or_node);
+    if(best < 0 || (or_node ? length < best_length : length > best_length)){
+      best = c;
+      best_length = length;
+    }
+  }
+  if(best < 0)
+    return;
+  line.push_back(_nodes[best].move);
+  proof_line(best, !or_node, line);
+}
+
+
+int ProofSearch::main(const vector<string>& args){
+  ProofLimits limits;
+  vector<string> positional;
+  for(size_t i = 0; i < args.size(); i++){
+    bool has_value = i + 1 < args.size();
+    if(args[i] == "--nodes" && has_value)
+      limits.nodes = std::atol(args[++i].c_str());
+    else if(args[i] == "--shortest")
+      limits.shortest = true;
+    else if(args[i] == "--memory" && has_value)
+      limits.memory = (size_t)std::atol(args[++i].c_str()) << 20;
+    else
+      positional.push_back(args[i]);
+  }
+  if(positional.size() < 2 || positional.size() > 3){
+    std::cerr << "Usage: play mate [--nodes N] [--memory MB] [--shortest] <game> <moves> [file]\n";
+    return 1;
+  }
+  int variant = std::atoi(positional[0].c_str());
+  limits.moves = std::atoi(positional[1].c_str());
+  ChessGame* game = nullptr;
+  try {
+    game = create_game(variant, positional.size() > 2 ? positional[2] : "");
+  }
+  catch(std::exception& e){
+    Prompts::load_failure();
+    return 1;
+  }
+  if(game == nullptr || limits.moves < 1 || 2 * limits.moves - 1 > MAX_PROOF_PLIES){
+    std::cerr << "Usage: play mate [--nodes N] [--memory MB] [--shortest] <game> <moves> [file]\n";
+    delete game;
+    return 1;
+  }
+  if(variant == SPOOKY_CHESS){
+    std::cerr << "Spooky Chess has no forced wins: the ghost moves at random\n";
+    delete game;
+    return 1;
+  }
+
+  ProofSearch search(*game);
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  ProofResult result = search.solve(limits);
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  if(result.status == PROVEN){
+    std::cout << "win in " << result.moves << ":";
+    for(size_t i = 0; i < result.line.size(); i++)
+      std::cout << (i == 0 ? " " : ", ") << game->move_text(result.line[i]);
+    std::cout << "\n";
+  }
+  else if(result.status == DISPROVEN)
+    std::cout << "no forced win in " << limits.moves << "\n";
+  else
+    std::cout << "unknown: out of nodes or memory\n";
+  std::cout << "nodes " << result.nodes << " time " << seconds << "s" << std::endl;
+  delete game;
+  return 0;
+}
@@ -0,0 +1,112 @@
+#ifndef PROOF_SEARCH_H
+#define PROOF_SEARCH_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "Move.h"
+#include "ChessGame.h"
+#include "HillChess.h"
+
+// Longest line a proof search looks at
+const int MAX_PROOF_PLIES = 127;
+
+// How a proof search ended
+enum ProofStatus {
+    PROVEN,     // the player to move forces a win within the limit
+    DISPROVEN,  // no forced win within the limit
+    UNKNOWN     // the node or memory budget ran out first
+};
+
+// How much work a proof search is allowed to do
+struct ProofLimits {
+    int moves;     // the win must come within this many of the attacker's moves
+    long nodes;    // positions visited, 0 for no limit
+    size_t memory; // bytes for the search tree
+    bool shortest; // rule out quicker wins first, at the cost of disproving them
+    ProofLimits(int m = 1, long n = 0, size_t bytes = 64 << 20) :
+        moves(m), nodes(n), memory(bytes), shortest(false) {}
+};
+
+// The outcome of a proof search
+struct ProofResult {
+    ProofStatus status;
+    int moves;              // when proven, the attacker moves the line takes
+    std::vector<Move> line; // when proven, the winning line against the longest defence
+    long nodes;             // positions visited
+    ProofResult() : status(UNKNOWN), moves(0), nodes(0) {}
+};
+
+
+// Proof-number search for forced wins of the player to move: checkmate,
+// and in King of the Hill also reaching the hill. The tree is kept in a
+// pool of nodes, each with the number of leaves that still have to be
+// proven (proof) or disproven (disproof) to settle it; every step plays
+// down to the most proving leaf with do_move, expands it and backs the
+// numbers up. Replies are scored by how many there are, so positions with
+// few defences are looked at first, which is what makes typical mates
+// quick to find. Draws and running out of moves count as failures.
+//
+// Spooky Chess is not solved: the ghost's landings are random, so there
+// is no forced line to prove, and such games always end UNKNOWN.
+class ProofSearch {
+
+public:
+
+    explicit ProofSearch(ChessGame& game);
+
+    // Look for a forced win within limits.moves moves of the player to move.
+    // Of the wins proven, the line is the quickest one against the defence
+    // that holds out longest; a quicker win may exist among moves the
+    // search never needed to look at, unless limits.shortest is set. The
+    // game is left as it was found.
+    ProofResult solve(const ProofLimits& limits);
+
+    // Command-line entry: play mate [--nodes N] [--memory MB] [--shortest] <game> <moves> [file]
+    static int main(const std::vector<std::string>& args);
+
+private:
+
+    // One position in the tree. Children of a node are next to each other
+    // in the pool. The root and every other ply (the attacker to move) are
+    // OR nodes, proven by one child; the rest are AND nodes, proven by all.
+    struct Node {
+        uint32_t proof;
+        uint32_t disproof;
+        int32_t first_child; // -1 until expanded
+        uint16_t children;
+        Move move;           // that led here
+    };
+
+    ChessGame& _game;
+    HillChess* _hill;   // nullptr unless playing King of the Hill
+    bool _solvable;     // false for Spooky Chess
+
+    std::vector<Node> _nodes;
+    size_t _capacity;   // nodes the memory budget holds
+    long _visited;
+    long _node_limit;
+    int _max_ply;       // plies of the current iteration
+
+    // Prove or disprove a win within _max_ply plies
+    ProofStatus prove();
+
+    // Give node, reached after ply plies, its children. Returns false if the
+    // pool is full.
+    bool expand(int node, int ply);
+
+    // Score the position just reached, ply plies from the root
+    void evaluate(Node& node, int ply);
+
+    // Recompute node's numbers from its children
+    void update(Node& node, bool or_node);
+
+    // Plies the proof below a proven node takes against the longest defence
+    int proof_length(int node, bool or_node) const;
+
+    // Append that line of play to line
+    void proof_line(int node, bool or_node, std::vector<Move>& line) const;
+
+};
+
+#endif // PROOF_SEARCH_H
@@ -0,0 +1,216 @@
+#include <vector>
+#include <algorithm>
+#include "ChessGame.h"
+#include "SpookyChess.h"
+#include "HillChess.h"
+#include "Evaluation.h"
+#include "Search.h"
+#include "EvalWeights.h"
+
+using std::vector;
+
+// Larger than any score a search can return
+static const int INFINITE_SCORE = MATE_SCORE + 1;
+
+// Pick the search that understands the variant being played
+Search* Search::for_game(ChessGame& game){
+  SpookyChess* spooky = dynamic_cast<SpookyChess*>(&game);
+  if(spooky != nullptr)
+    return new ExpectimaxSearch(*spooky);
+  HillChess* hill = dynamic_cast<HillChess*>(&game);
+  if(hill != nullptr)
+    return new HillSearch(*hill);
+  return new Search(game);
+}
+
+// Iterative deepening: search depth 1, 2, ... keeping the result of the
+// deepest iteration that finished within the node budget
+SearchResult Search::run(const SearchLimits& limits){
+  SearchResult result;
+  _nodes = 0;
+  _node_limit = limits.nodes;
+  _time = limits.time;
+  _stop = limits.stop;
+  _stopped = false;
+
+  MoveList moves;
+  _game.legal_moves(moves);
+  if(!limits.root_moves.empty()){ //keep only the requested moves
+    MoveList all = moves;
+    moves.clear();
+    for(int i = 0; i < all.size(); i++){
+      if(std::find(limits.root_moves.begin(), limits.root_moves.end(), all[i]) != limits.root_moves.end())
+	moves.push(all[i]);
+    }
+  }
+  if(moves.empty())
+    return result;
+
+  //whole-position searches can be answered from and kept in the cache
+  AnalysisCache* cache = limits.root_moves.empty() ? limits.cache : nullptr;
+  CachedAnalysis cached;
+  if(cache != nullptr && cache->probe(cache_key(), limits.depth, cached)){
+    for(int i = 0; i < moves.size(); i++){
+      if(moves[i] == cached.best){ //a key collision can't hand back an illegal move
+	result.found = true;
+	result.best = moves[i];
+	result.score = cached.score;
+	result.depth = cached.depth;
+	return result;
+      }
+    }
+  }
+
+  order_moves(moves);
+  result.found = true;
+  result.best = moves[0];
+
+  for(int depth = 1; depth <= limits.depth && depth < MAX_PLY; depth++){
+    int alpha = -INFINITE_SCORE;
+    int best = 0;
+    for(int i = 0; i < moves.size(); i++){
+      MoveRecord record;
+      _game.do_move(moves[i], record);
+      int score = -child_score(depth - 1, -INFINITE_SCORE, -alpha, 1);
+      _game.undo_move(record);
+      if(_stopped)
+	break;
+      if(score > alpha){
+	alpha = score;
+	best = i;
+      }
+    }
+    if(_stopped) //unfinished iteration, keep the previous answer
+      break;
+    result.best = moves[best];
+    result.score = alpha;
+    result.depth = depth;
+    //search the best move first in the next iteration
+    std::rotate(moves.begin(), moves.begin() + best, moves.begin() + best + 1);
+    if(limits.progress)
+      limits.progress(result);
+    if(_time != nullptr && (moves.size() == 1 || !_time->next_iteration(result.best)))
+      break; //nothing to choose from, or no time for another iteration
+  }
+  result.nodes = _nodes;
+  if(cache != nullptr && result.depth > 0){
+    CachedAnalysis analysis = {result.best, result.score, result.depth};
+    cache->store(cache_key(), analysis);
+  }
+  return result;
+}
+
+// Plain negamax with alpha-beta pruning
+int Search::negamax(int depth, int alpha, int beta, int ply){
+  _nodes++;
+  if(_node_limit > 0 && _nodes >= _node_limit)
+    _stopped = true;
+  if((_nodes & 1023) == 0 && ((_time != nullptr && _time->out_of_time()) || (_stop != nullptr && *_stop)))
+    _stopped = true; //checked now and then, as reading the clock is not free
+  if(_stopped)
+    return 0;
+  if(_game.repetitions() > 0 || _game.fifty_moves() || _game.insufficient_material())
+    return 0; //the cycle can be kept up, or no one can win
+  if(depth <= 0 || ply >= MAX_PLY)
+    return evaluate();
+
+  MoveList moves;
+  _game.legal_moves(moves);
+  if(moves.empty()){ //checkmate or stalemate
+    if(_game.check(_game.opponent()))
+      return -MATE_SCORE + ply; //prefer the quickest mate
+    return 0;
+  }
+  order_moves(moves);
+
+  for(int i = 0; i < moves.size(); i++){
+    MoveRecord record;
+    _game.do_move(moves[i], record);
+    int score = -child_score(depth - 1, -beta, -alpha, ply + 1);
+    _game.undo_move(record);
+    if(_stopped)
+      return 0;
+    if(score > alpha)
+      alpha = score;
+    if(alpha >= beta)
+      break;
+  }
+  return alpha;
+}
+
+// In standard chess nothing happens between two moves
+int Search::child_score(int depth, int alpha, int beta, int ply){
+  return negamax(depth, alpha, beta, ply);
+}
+
+// Endgames with a rule of their own first. The hill race is no such
+// endgame, so HillSearch doesn't use them.
+int Search::evaluate(){
+  int score;
+  if(Evaluation::endgame(_game, score))
+    return score;
+  return Evaluation::evaluate(_game, &_pawns);
+}
+
+// Stable sort with captures ahead of quiet moves
+void Search::order_moves(MoveList& moves) const{
+  std::stable_partition(moves.begin(), moves.end(), [](const Move& m){
+      return m.is(Move::CAPTURE);
+    });
+}
+
+// Chance node: average the position over every ghost landing, weighted by
+// how many of the random squares each outcome stands for. Bounds from the
+// parent cannot be applied to a single outcome, so each is searched with a
+// full window.
+int ExpectimaxSearch::child_score(int depth, int, int, int ply){
+  vector<GhostOutcome> outcomes;
+  int total = _spooky.ghost_outcomes(outcomes, _empty_groups);
+  int from = _spooky.ghost_square();
+  long sum = 0;
+  for(size_t i = 0; i < outcomes.size() && !_stopped; i++){
+    Piece* captured = _spooky.place_ghost(outcomes[i].square);
+    sum += (long)outcomes[i].weight * negamax(depth, -INFINITE_SCORE, INFINITE_SCORE, ply);
+    _spooky.unplace_ghost(from, captured);
+  }
+  return total > 0 ? (int)(sum / total) : negamax(depth, -INFINITE_SCORE, INFINITE_SCORE, ply);
+}
+
+// Spooky positions are keyed apart from standard ones with the same pieces
+uint64_t ExpectimaxSearch::cache_key() const{
+  return _game.position_hash() ^ 0x5be6f6c2a1d38e47ULL;
+}
+
+// The player who just moved wins if their king is now on the hill
+int HillSearch::child_score(int depth, int alpha, int beta, int ply){
+  if(_hill.hill_winner() != NO_ONE)
+    return -MATE_SCORE + ply;
+  return negamax(depth, alpha, beta, ply);
+}
+
+// Standard evaluation plus the race to the hill
+int HillSearch::evaluate(){
+  int score = Evaluation::evaluate(_hill, &_pawns);
+  int mine = _hill.hill_distance(_hill.player_turn());
+  int theirs = _hill.hill_distance(_hill.opponent());
+  if(mine < 4)
+    score += HILL_BONUS[mine];
+  if(theirs < 4)
+    score -= HILL_BONUS[theirs];
+  return score;
+}
+
+// King moves onto the hill win outright, so they go in front of everything
+void HillSearch::order_moves(MoveList& moves) const{
+  Search::order_moves(moves);
+  int king = _hill.king_square(_hill.player_turn());
+  uint64_t hill = _hill.hill_mask();
+  std::stable_partition(moves.begin(), moves.end(), [king, hill](const Move& m){
+      return m.from() == king && ((hill >> m.to()) & 1);
+    });
+}
+
+// Hill positions are keyed apart from standard ones with the same pieces
+uint64_t HillSearch::cache_key() const{
+  return _game.position_hash() ^ 0x9d0c8a3e71f2b564ULL;
+}
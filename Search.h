@@ -0,0 +1,144 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <vector>
+#include <atomic>
+#include <functional>
+#include "Enumerations.h"
+#include "Move.h"
+#include "ChessGame.h"
+#include "SpookyChess.h"
+#include "HillChess.h"
+#include "Evaluation.h"
+#include "AnalysisCache.h"
+#include "Clock.h"
+
+// Scores at or beyond MATE_SCORE - MAX_PLY mean a forced mate
+const int MATE_SCORE = 100000;
+const int MAX_PLY = 64;
+
+struct SearchResult;
+
+// How much work a search is allowed to do
+struct SearchLimits {
+    int depth;  // maximum depth in plies
+    long nodes; // node budget, 0 for no limit
+    std::vector<Move> root_moves; // only search these moves at the root, all if empty
+    AnalysisCache* cache; // answers kept from earlier searches, nullptr for none
+    TimeManager* time;    // time budget, nullptr for none
+    const std::atomic<bool>* stop; // set by another thread to stop, nullptr for none
+    std::function<void(const SearchResult&)> progress; // told the answer after every iteration, if set
+    SearchLimits(int d = 3, long n = 0) : depth(d), nodes(n), cache(nullptr), time(nullptr), stop(nullptr) {}
+};
+
+// The outcome of a search
+struct SearchResult {
+    bool found;       // false if there was no legal move
+    Move best;        // best move found
+    int score;        // centipawns from the point of view of the player to move
+    int depth;        // deepest fully searched iteration
+    long nodes;       // positions visited
+    SearchResult() : found(false), score(0), depth(0), nodes(0) {}
+};
+
+
+// Depth-limited alpha-beta search over a ChessGame. The game is walked with
+// do_move/undo_move and is left exactly as it was found.
+class Search {
+
+public:
+
+    explicit Search(ChessGame& game) :
+        _game(game), _nodes(0), _node_limit(0), _time(nullptr), _stop(nullptr), _stopped(false) {}
+
+    virtual ~Search() {}
+
+    // Create the search suited to the variant being played. Caller owns the result.
+    static Search* for_game(ChessGame& game);
+
+    // Search the current position with iterative deepening up to the limits.
+    // A search that is stopped or runs out of time or nodes returns the
+    // answer of the deepest iteration it finished.
+    // With a cache, a position already analysed deeply enough is answered
+    // from it without searching (nodes is then 0), and new results are kept.
+    SearchResult run(const SearchLimits& limits);
+
+    // Key of the current position in an AnalysisCache. Variants mix in
+    // their own constant so their answers never collide.
+    virtual uint64_t cache_key() const { return _game.position_hash(); }
+
+protected:
+
+    ChessGame& _game;
+
+    long _nodes;      // positions visited so far
+    long _node_limit; // 0 when unlimited
+    TimeManager* _time;
+    const std::atomic<bool>* _stop;
+    bool _stopped;    // set once the node or time budget runs out, or on a stop request
+
+    PawnTable _pawns; // pawn structures seen by this search
+
+    // Negamax alpha-beta. Returns the score for the player to move.
+    int negamax(int depth, int alpha, int beta, int ply);
+
+    // Score the position just reached by a move, for the player now to move.
+    // Variants with something happening between turns override this.
+    virtual int child_score(int depth, int alpha, int beta, int ply);
+
+    // Static score of the current position for the player to move
+    virtual int evaluate();
+
+    // Put captures first so alpha-beta cuts sooner
+    virtual void order_moves(MoveList& moves) const;
+
+};
+
+
+// Expectimax search for SpookyChess. After every move the ghost jumps to a
+// random square, so each move is followed by a chance node that averages
+// the scores of the ghost's possible landings.
+class ExpectimaxSearch : public Search {
+
+public:
+
+    // empty_groups bounds how many outcomes the quiet ghost landings are merged into
+    ExpectimaxSearch(SpookyChess& game, int empty_groups = 4) :
+        Search(game), _spooky(game), _empty_groups(empty_groups) {}
+
+protected:
+
+    SpookyChess& _spooky;
+    int _empty_groups;
+
+    int child_score(int depth, int alpha, int beta, int ply) override;
+
+    uint64_t cache_key() const override;
+
+};
+
+
+// Search for King of the Hill. A king reaching the hill ends the game, so
+// such moves are tried first and scored as wins without searching deeper,
+// and the evaluation rewards kings that are close to the hill.
+class HillSearch : public Search {
+
+public:
+
+    explicit HillSearch(HillChess& game) : Search(game), _hill(game) {}
+
+protected:
+
+    HillChess& _hill;
+
+    int child_score(int depth, int alpha, int beta, int ply) override;
+
+    int evaluate() override;
+
+    void order_moves(MoveList& moves) const override;
+
+    uint64_t cache_key() const override;
+
+};
+
+#endif // SEARCH_H
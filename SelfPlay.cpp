@@ -0,0 +1,142 @@
+#include <string>
+#include <vector>
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+#include "Game.h"
+#include "ChessGame.h"
+#include "HillChess.h"
+#include "Search.h"
+#include "ThreadPool.h"
+#include "Variants.h"
+#include "SelfPlay.h"
+
+using std::string;
+using std::vector;
+
+// xorshift64, enough to vary the openings; never seeded with 0
+static uint64_t next_random(uint64_t& state){
+  state ^= state << 13;
+  state ^= state >> 7;
+  state ^= state << 17;
+  return state;
+}
+
+// Result of a finished game for white: 1 win, 0 draw, -1 loss
+static int white_result(ChessGame& game, int outcome){
+  if(outcome == CHECKMATE) //the player to move is mated
+    return game.player_turn() == WHITE ? -1 : 1;
+  if(outcome == GAME_WIN){
+    HillChess* hill = dynamic_cast<HillChess*>(&game);
+    if(hill != nullptr && hill->hill_winner() != NO_ONE)
+      return hill->hill_winner() == WHITE ? 1 : -1;
+  }
+  return 0;
+}
+
+void SelfPlay::play(int n){
+  int variant = _options.variant != 0 ? _options.variant : STANDARD_CHESS + n % 3;
+  ChessGame* game = create_game(variant, "");
+  uint64_t random = (_options.seed + n) * 0x9e3779b97f4a7c15ULL | 1;
+  vector<uint8_t> records;
+  MoveList moves;
+  int outcome = 0;
+  int ply = 0;
+  for(; ply < _options.max_plies; ply++){
+    outcome = game->outcome();
+    if(outcome != 0)
+      break;
+    Move move;
+    if(ply < _options.random_plies){
+      game->legal_moves(moves);
+      move = moves[next_random(random) % moves.size()];
+    }
+    else {
+      Search* search = Search::for_game(*game);
+      SearchResult result = search->run(SearchLimits(_options.depth, _options.nodes));
+      delete search;
+      if(!result.found)
+	break;
+      records.resize(records.size() + RECORD_SIZE);
+      pack_position(*game, variant, result.score, ply, &records[records.size() - RECORD_SIZE]);
+      move = result.best;
+    }
+    game->play_turn(move);
+  }
+  if(ply == _options.max_plies)
+    outcome = game->outcome();
+
+  int result = white_result(*game, outcome);
+  int count = records.size() / RECORD_SIZE;
+  for(int i = 0; i < count; i++)
+    set_result(&records[i * RECORD_SIZE], result);
+  if(count > 0)
+    _writer.add(records.data(), count);
+  _positions += count;
+  delete game;
+}
+
+void SelfPlay::run(){
+  ThreadPool pool(_options.threads);
+  for(int n = 0; n < _options.games; n++)
+    pool.submit([this, n](int){ play(n); });
+  pool.wait();
+}
+
+int SelfPlay::main(const vector<string>& args){
+  SelfPlayOptions options = {100, 0, 3, 20000, ThreadPool::hardware_threads(), 8, 300, 1};
+  long shard_size = 0;
+  string output;
+  bool bad = false;
+  for(size_t i = 0; i < args.size(); i++){
+    bool has_value = i + 1 < args.size();
+    if(args[i] == "--games" && has_value)
+      options.games = std::atoi(args[++i].c_str());
+    else if(args[i] == "--variant" && has_value)
+      options.variant = std::atoi(args[++i].c_str());
+    else if(args[i] == "--depth" && has_value)
+      options.depth = std::atoi(args[++i].c_str());
+    else if(args[i] == "--nodes" && has_value)
+      options.nodes = std::atol(args[++i].c_str());
+    else if(args[i] == "--threads" && has_value)
+      options.threads = std::atoi(args[++i].c_str());
+    else if(args[i] == "--random-plies" && has_value)
+      options.random_plies = std::atoi(args[++i].c_str());
+    else if(args[i] == "--max-plies" && has_value)
+      options.max_plies = std::atoi(args[++i].c_str());
+    else if(args[i] == "--seed" && has_value)
+      options.seed = std::strtoull(args[++i].c_str(), nullptr, 10);
+    else if(args[i] == "--shard-size" && has_value)
+      shard_size = std::atol(args[++i].c_str());
+    else if(args[i] == "--out" && has_value)
+      output = args[++i];
+    else
+      bad = true;
+  }
+  if(bad || output.empty() || options.games < 1 || options.depth < 1 || options.variant < 0 || options.variant > SPOOKY_CHESS){
+    std::cerr << "Usage: play selfplay [--games N] [--variant N] [--depth N] [--nodes N] [--threads N]\n"
+	      << "         [--random-plies N] [--max-plies N] [--seed N] [--shard-size N] --out PATH\n";
+    return 1;
+  }
+
+  TrainingWriter writer;
+  if(!writer.open(output, shard_size)){
+    std::cerr << "Can't write training data to " << output << "\n";
+    return 1;
+  }
+  SelfPlay self_play(options, writer);
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  self_play.run();
+  bool written = writer.close();
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::cout << "games " << options.games << " positions " << self_play.positions()
+	    << " time " << seconds << "s";
+  if(seconds > 0)
+    std::cout << " positions/s " << (long)(self_play.positions() / seconds);
+  std::cout << std::endl;
+  if(!written){
+    std::cerr << "Writing " << output << " failed\n";
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,55 @@
+#ifndef SELF_PLAY_H
+#define SELF_PLAY_H
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include "TrainingData.h"
+
+// How self-play games are played
+struct SelfPlayOptions {
+    int games;         // games to play
+    int variant;       // GameName, 0 to take turns through every variant
+    int depth;         // search depth per move
+    long nodes;        // node budget per move, 0 for no limit
+    int threads;       // games played at once
+    int random_plies;  // opening plies played at random and not recorded
+    int max_plies;     // a game this long is scored as a draw
+    uint64_t seed;     // seed of the random openings
+};
+
+// Self-play training data: engines play each other on a ThreadPool, one
+// task per game. Every searched position is packed with its score, and once
+// the game is over the records get its result and go to a TrainingWriter,
+// which writes them while the games go on.
+class SelfPlay {
+
+public:
+
+    SelfPlay(const SelfPlayOptions& options, TrainingWriter& writer) :
+        _options(options), _writer(writer), _positions(0) {}
+
+    // Play every game
+    void run();
+
+    // Number of positions recorded
+    long positions() const { return _positions; }
+
+    // Command-line entry: play selfplay [--games N] [--variant N] [--depth N]
+    // [--nodes N] [--threads N] [--random-plies N] [--max-plies N]
+    // [--seed N] [--shard-size N] --out PATH
+    static int main(const std::vector<std::string>& args);
+
+private:
+
+    SelfPlayOptions _options;
+    TrainingWriter& _writer;
+    std::atomic<long> _positions;
+
+    // Play game number n; runs on a worker thread
+    void play(int n);
+
+};
+
+#endif // SELF_PLAY_H
@@ -0,0 +1,579 @@
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <iostream>
+#include <cstring>
+#include <cstdlib>
+#include <csignal>
+#include <ctime>
+#include <new>
+#include <memory>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "Game.h"
+#include "ChessGame.h"
+#include "Move.h"
+#include "Variants.h"
+#include "Service.h"
+
+using std::string;
+using std::vector;
+
+static const char MAGIC[4] = {'C', 'G', 'S', 'V'};
+static const char* DEFAULT_NAME = "/chessgame";
+static const uint32_t NO_ENTRY = 0xffffffff;
+
+// Round a size up to whole cache lines
+static size_t lines(size_t bytes){
+  return (bytes + 63) / 64 * 64;
+}
+
+// Bytes taken by a region and where its parts start
+static size_t region_size(uint32_t clients, uint32_t games, size_t& rings, size_t& table){
+  rings = lines(sizeof(ServiceHeader));
+  table = rings + lines(sizeof(ServiceRing) * clients);
+  return table + lines(sizeof(ServiceGame) * games);
+}
+
+// Spin while waiting for the other side; after a while, stop burning the
+// core. Returns the updated count of empty polls.
+static int back_off(int idle){
+  if(idle < 1000)
+    return idle + 1;
+  if(idle < 2000){
+    sched_yield();
+    return idle + 1;
+  }
+  struct timespec pause = {0, 50000}; //50us
+  nanosleep(&pause, nullptr);
+  return idle;
+}
+
+// How often, in ms, the server looks for rings of clients that died
+static const int RECLAIM_INTERVAL = 1000;
+
+// Attempts of ServiceClient::read_game: the spins and yields of back_off,
+// then naps for a fraction of a second, far longer than writing a game takes
+static const int READ_TRIES = 4000;
+
+ServiceServer::ServiceServer() : _fd(-1), _map(nullptr), _size(0), _header(nullptr), _rings(nullptr), _games(nullptr) {
+  for(int v = 0; v <= SPOOKY_CHESS; v++){
+    _scratch[v] = nullptr;
+    _loaded[v] = NO_ENTRY;
+  }
+}
+
+ServiceServer::~ServiceServer(){
+  if(_header != nullptr)
+    _header->running.store(0, std::memory_order_release);
+  if(_map != nullptr)
+    munmap(_map, _size);
+  if(_fd >= 0){
+    close(_fd);
+    shm_unlink(_name.c_str());
+  }
+  for(int v = 0; v <= SPOOKY_CHESS; v++)
+    delete _scratch[v];
+}
+
+bool ServiceServer::create(const string& name, int clients, int games){
+  if(clients < 1 || games < 1)
+    return false;
+  for(int v = STANDARD_CHESS; v <= SPOOKY_CHESS; v++){
+    _scratch[v] = create_game(v, "");
+    _scratch[v]->export_state(_start[v]);
+  }
+
+  size_t rings, table;
+  _size = region_size(clients, games, rings, table);
+  _name = name;
+  shm_unlink(name.c_str()); //a region left by a server that died
+  _fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+  if(_fd < 0)
+    return false;
+  if(ftruncate(_fd, _size) != 0)
+    return false;
+  _map = mmap(nullptr, _size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+  if(_map == MAP_FAILED){
+    _map = nullptr;
+    return false;
+  }
+
+  //the new region is zero filled; construct the atomics in place
+  char* base = static_cast<char*>(_map);
+  _header = new (base) ServiceHeader();
+  _rings = reinterpret_cast<ServiceRing*>(base + rings);
+  _games = reinterpret_cast<ServiceGame*>(base + table);
+  for(int c = 0; c < clients; c++)
+    new (&_rings[c]) ServiceRing();
+  for(int g = games - 1; g >= 0; g--){
+    new (&_games[g]) ServiceGame();
+    _free.push_back(g);
+  }
+  memcpy(_header->magic, MAGIC, sizeof MAGIC);
+  _header->clients = clients;
+  _header->games = games;
+  _header->running.store(1, std::memory_order_release); //clients may connect now
+  return true;
+}
+
+ChessGame* ServiceServer::load(uint32_t id){
+  if(id >= _header->games || _games[id].variant == 0)
+    return nullptr;
+  int variant = _games[id].variant;
+  if(_loaded[variant] != id){
+    _scratch[variant]->import_state(_games[id].state);
+    _loaded[variant] = id;
+  }
+  return _scratch[variant];
+}
+
+void ServiceServer::store(uint32_t id, ChessGame& game){
+  ServiceGame& entry = _games[id];
+  int outcome = game.outcome();
+  uint32_t sequence = entry.sequence.load(std::memory_order_relaxed);
+  entry.sequence.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  game.export_state(entry.state);
+  entry.outcome = outcome;
+  entry.sequence.store(sequence + 2, std::memory_order_release);
+}
+
+void ServiceServer::handle(const ServiceRequest& request, ServiceResponse& response){
+  response.tag = request.tag;
+  response.game = request.game;
+  response.to_move = 0;
+  response.status = LOAD_FAILURE;
+
+  if(request.op == SERVICE_NEW){
+    if(request.variant < STANDARD_CHESS || request.variant > SPOOKY_CHESS || _free.empty())
+      return;
+    uint32_t id = _free.back();
+    _free.pop_back();
+    ServiceGame& entry = _games[id];
+    entry.sequence.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    entry.variant = request.variant;
+    entry.outcome = 0;
+    entry.state = _start[request.variant];
+    entry.sequence.fetch_add(1, std::memory_order_release);
+    response.game = id;
+    response.status = SUCCESS;
+    response.to_move = WHITE;
+    return;
+  }
+
+  ChessGame* game = load(request.game);
+  if(game == nullptr)
+    return;
+  switch(request.op){
+  case SERVICE_FREE: {
+    ServiceGame& entry = _games[request.game];
+    entry.sequence.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    entry.variant = 0;
+    entry.sequence.fetch_add(1, std::memory_order_release);
+    for(int v = 0; v <= SPOOKY_CHESS; v++){
+      if(_loaded[v] == request.game)
+	_loaded[v] = NO_ENTRY;
+    }
+    _free.push_back(request.game);
+    response.status = SUCCESS;
+    break;
+  }
+  case SERVICE_VALIDATE:
+  case SERVICE_APPLY: {
+    //the same checks as ChessGame::check_turn, with the outcome taken from the table
+    int squares = game->width() * game->height();
+    if(request.from < 0 || request.from >= squares || request.to < 0 || request.to >= squares){
+      response.status = MOVE_ERROR_OUT_OF_BOUNDS;
+      break;
+    }
+    if(_games[request.game].outcome != 0){
+      response.status = MOVE_ERROR_ILLEGAL;
+      break;
+    }
+    int width = game->width();
+    Move m(request.from, request.to);
+    response.status = game->check_move(Position(m.from() % width, m.from() / width),
+				       Position(m.to() % width, m.to() / width));
+    if(request.op == SERVICE_APPLY && response.status > 0){
+      response.status = game->play_checked_turn(m, response.status);
+      store(request.game, *game);
+    }
+    break;
+  }
+  case SERVICE_STATUS:
+    response.status = _games[request.game].outcome;
+    break;
+  default:
+    response.status = PARSE_ERROR;
+  }
+  response.to_move = game->player_turn();
+}
+
+void ServiceServer::serve(const std::atomic<bool>& stop){
+  int idle = 0;
+  std::chrono::steady_clock::time_point next_reclaim = std::chrono::steady_clock::now();
+  while(!stop.load(std::memory_order_relaxed)){
+    bool worked = false;
+    for(uint32_t c = 0; c < _header->clients; c++){
+      ServiceRing& ring = _rings[c];
+      uint32_t end = ring.requests_written.value.load(std::memory_order_acquire);
+      uint32_t next = ring.requests_read.value.load(std::memory_order_relaxed);
+      if(next == end)
+	continue;
+      uint32_t out = ring.responses_written.value.load(std::memory_order_relaxed);
+      uint32_t read = ring.responses_read.value.load(std::memory_order_acquire);
+      if(out - read >= SERVICE_RING) //never over a response the client hasn't read
+	continue;
+      for(; next != end && out - read < SERVICE_RING; next++, out++)
+	handle(ring.requests[next % SERVICE_RING], ring.responses[out % SERVICE_RING]);
+      ring.responses_written.value.store(out, std::memory_order_release);
+      ring.requests_read.value.store(next, std::memory_order_release);
+      worked = true;
+    }
+    idle = worked ? 0 : back_off(idle);
+    if(!worked && std::chrono::steady_clock::now() >= next_reclaim){
+      reclaim();
+      next_reclaim = std::chrono::steady_clock::now() + std::chrono::milliseconds(RECLAIM_INTERVAL);
+    }
+  }
+}
+
+// The dead client can't touch its ring any more, so the server may set the
+// client's indices too; the ring is freed last
+void ServiceServer::reclaim(){
+  for(uint32_t c = 0; c < _header->clients; c++){
+    ServiceRing& ring = _rings[c];
+    uint32_t owner = ring.claimed.load(std::memory_order_acquire);
+    if(owner == 0 || kill((pid_t)owner, 0) == 0 || errno != ESRCH)
+      continue;
+    ring.requests_read.value.store(ring.requests_written.value.load(std::memory_order_acquire), std::memory_order_release);
+    ring.responses_read.value.store(ring.responses_written.value.load(std::memory_order_relaxed), std::memory_order_release);
+    ring.claimed.compare_exchange_strong(owner, 0, std::memory_order_release);
+  }
+}
+
+static std::atomic<bool> stop_serving(false);
+
+static void on_signal(int){
+  stop_serving.store(true);
+}
+
+int ServiceServer::main(const vector<string>& args){
+  int clients = 8, games = 4096;
+  string name = DEFAULT_NAME;
+  for(size_t i = 0; i < args.size(); i++){
+    bool has_value = i + 1 < args.size();
+    if(args[i] == "--clients" && has_value)
+      clients = std::atoi(args[++i].c_str());
+    else if(args[i] == "--games" && has_value)
+      games = std::atoi(args[++i].c_str());
+    else
+      name = args[i];
+  }
+  ServiceServer server;
+  if(!server.create(name, clients, games)){
+    std::cerr << "Can't create shared memory " << name << "\n";
+    return 1;
+  }
+  signal(SIGINT, on_signal);
+  signal(SIGTERM, on_signal);
+  std::cerr << "Serving " << games << " games to " << clients << " clients at " << name << "\n";
+  server.serve(stop_serving);
+  return 0;
+}
+
+
+ServiceClient::~ServiceClient(){
+  if(_ring != nullptr)
+    _ring->claimed.store(0, std::memory_order_release);
+  if(_map != nullptr)
+    munmap(_map, _size);
+  if(_fd >= 0)
+    close(_fd);
+}
+
+bool ServiceClient::connect(const string& name){
+  _fd = shm_open(name.c_str(), O_RDWR, 0);
+  if(_fd < 0)
+    return false;
+  ServiceHeader header;
+  if(pread(_fd, &header, sizeof header, 0) != (ssize_t)sizeof header
+     || memcmp(header.magic, MAGIC, sizeof MAGIC) != 0)
+    return false;
+  size_t rings, table;
+  _size = region_size(header.clients, header.games, rings, table);
+  _map = mmap(nullptr, _size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+  if(_map == MAP_FAILED){
+    _map = nullptr;
+    return false;
+  }
+  char* base = static_cast<char*>(_map);
+  _header = reinterpret_cast<ServiceHeader*>(base);
+  _games = reinterpret_cast<ServiceGame*>(base + table);
+  if(_header->running.load(std::memory_order_acquire) == 0)
+    return false;
+
+  ServiceRing* rings_start = reinterpret_cast<ServiceRing*>(base + rings);
+  for(uint32_t c = 0; c < _header->clients && _ring == nullptr; c++){
+    uint32_t expected = 0;
+    if(rings_start[c].claimed.compare_exchange_strong(expected, (uint32_t)getpid(), std::memory_order_acquire))
+      _ring = &rings_start[c];
+  }
+  if(_ring == nullptr)
+    return false;
+
+  //let the server finish what an earlier owner left, dropping its
+  //responses as they come so that the server has room for them
+  _written = _ring->requests_written.value.load(std::memory_order_relaxed);
+  int idle = 0;
+  while(_ring->requests_read.value.load(std::memory_order_acquire) != _written){
+    if(_header->running.load(std::memory_order_relaxed) == 0)
+      return false;
+    _ring->responses_read.value.store(_ring->responses_written.value.load(std::memory_order_acquire),
+				      std::memory_order_release);
+    idle = back_off(idle);
+  }
+  _received = _ring->responses_written.value.load(std::memory_order_acquire);
+  _ring->responses_read.value.store(_received, std::memory_order_release);
+  return true;
+}
+
+ServiceRequest* ServiceClient::reserve(){
+  if(_written - _received >= SERVICE_RING)
+    return nullptr;
+  return &_ring->requests[_written++ % SERVICE_RING];
+}
+
+void ServiceClient::publish(){
+  _ring->requests_written.value.store(_written, std::memory_order_release);
+}
+
+int ServiceClient::wait(const ServiceResponse*& first){
+  int idle = 0;
+  uint32_t end;
+  while((end = _ring->responses_written.value.load(std::memory_order_acquire)) == _received){
+    if(_header->running.load(std::memory_order_relaxed) == 0)
+      return 0;
+    idle = back_off(idle);
+  }
+  uint32_t slot = _received % SERVICE_RING;
+  uint32_t ready = end - _received;
+  if(ready > SERVICE_RING - slot) //stop at the end of the ring
+    ready = SERVICE_RING - slot;
+  first = &_ring->responses[slot];
+  return ready;
+}
+
+void ServiceClient::release(int count){
+  _received += count;
+  _ring->responses_read.value.store(_received, std::memory_order_release);
+}
+
+bool ServiceClient::read_game(uint32_t game, BoardState& state) const{
+  if(game >= _header->games)
+    return false;
+  const ServiceGame& entry = _games[game];
+  int idle = 0;
+  for(int tries = 0; tries < READ_TRIES; tries++){
+    uint32_t before = entry.sequence.load(std::memory_order_acquire);
+    if(before % 2 == 0){ //not being written
+      bool used = entry.variant != 0;
+      memcpy(&state, &entry.state, sizeof state);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if(entry.sequence.load(std::memory_order_relaxed) == before)
+        return used;
+    }
+    if(_header->running.load(std::memory_order_relaxed) == 0)
+      return false;
+    idle = back_off(idle);
+  }
+  return false; //a server that died mid-write leaves the sequence odd for good
+}
+
+// A game of a load test connection, played along on the client's side so
+// that its moves are legal
+struct LoadGame {
+  uint32_t id;
+  bool pending;                    // waiting for the id of a new game
+  std::unique_ptr<ChessGame> game; // the position the server has
+  MoveList moves;                  // its legal moves
+};
+
+// Tag of a SERVICE_NEW request, with the index of the game it replaces
+static const uint32_t NEW_TAG = 0x80000000;
+
+// Ask for a new game in place of games[slot]
+static bool request_game(ServiceClient& client, vector<LoadGame>& games, uint32_t slot){
+  ServiceRequest* r = client.reserve();
+  if(r == nullptr)
+    return false;
+  r->op = SERVICE_NEW;
+  r->variant = STANDARD_CHESS + slot % 3;
+  r->tag = NEW_TAG | slot;
+  games[slot].pending = true;
+  return true;
+}
+
+// Take the ids of new games out of the responses. Returns how many moves
+// applied were rejected, which would mean the copies went wrong.
+static long receive(const ServiceResponse* first, int ready, vector<LoadGame>& games){
+  long rejected = 0;
+  for(int i = 0; i < ready; i++){
+    if(first[i].tag & NEW_TAG){
+      LoadGame& g = games[first[i].tag & ~NEW_TAG];
+      if(first[i].status <= 0) //the table is full: the slot stays pending
+	continue;
+      g.id = first[i].game;
+      g.game.reset(create_game(STANDARD_CHESS + (first[i].tag & ~NEW_TAG) % 3, ""));
+      g.game->legal_moves(g.moves);
+      g.pending = false;
+    }
+    else if(first[i].tag == SERVICE_APPLY && first[i].status < 0)
+      rejected++;
+  }
+  return rejected;
+}
+
+// One load test connection: start its games, then send batches of
+// queries for the given time, each about a move drawn from the legal ones.
+// A game that is over is freed and replaced. Returns the number of answered
+// queries.
+static long load_client(const string& name, int count, int batch, double seconds, uint32_t seed, long& rejected){
+  ServiceClient client;
+  if(!client.connect(name))
+    return -1;
+  vector<LoadGame> games(std::min(count, (int)SERVICE_RING));
+  int sent = 0;
+  for(uint32_t slot = 0; slot < games.size() && request_game(client, games, slot); slot++)
+    sent++;
+  client.publish();
+  while(sent > 0){
+    const ServiceResponse* first;
+    int ready = client.wait(first);
+    if(ready == 0)
+      return -1;
+    receive(first, ready, games);
+    client.release(ready);
+    sent -= ready;
+  }
+
+  uint32_t x = seed | 1; //xorshift
+  long answered = 0;
+  std::chrono::steady_clock::time_point stop = std::chrono::steady_clock::now()
+    + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds));
+  while(std::chrono::steady_clock::now() < stop){
+    sent = 0;
+    for(int tries = 0; sent < batch && tries < 4 * batch; tries++){
+      x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+      uint32_t slot = x % games.size();
+      LoadGame& g = games[slot];
+      if(g.pending)
+	continue;
+      ServiceRequest* r = client.reserve();
+      if(r == nullptr)
+	break;
+      sent++;
+      r->game = g.id;
+      if(g.moves.empty()){ //over: free it and start another
+	r->op = SERVICE_FREE;
+	r->tag = SERVICE_FREE;
+	if(request_game(client, games, slot))
+	  sent++;
+	continue;
+      }
+      Move m = g.moves[(x >> 8) % g.moves.size()];
+      r->op = (x >> 20) % 8 == 0 ? SERVICE_STATUS : ((x >> 20) % 8 == 1 ? SERVICE_APPLY : SERVICE_VALIDATE);
+      r->from = m.from();
+      r->to = m.to();
+      r->tag = r->op;
+      if(r->op == SERVICE_APPLY){ //later requests of the batch see the move
+	g.game->play_turn(m);
+	if(g.game->outcome() == 0)
+	  g.game->legal_moves(g.moves);
+	else
+	  g.moves.clear();
+      }
+    }
+    client.publish();
+    for(int left = sent; left > 0; ){
+      const ServiceResponse* first;
+      int ready = client.wait(first);
+      if(ready == 0)
+	return answered;
+      rejected += receive(first, ready, games);
+      client.release(ready);
+      left -= ready;
+      answered += ready;
+    }
+  }
+  for(size_t slot = 0; slot < games.size(); slot++){
+    if(games[slot].pending)
+      continue;
+    ServiceRequest* r = client.reserve();
+    if(r == nullptr)
+      break;
+    r->op = SERVICE_FREE;
+    r->game = games[slot].id;
+    r->tag = SERVICE_FREE;
+  }
+  client.publish();
+  return answered;
+}
+
+int ServiceClient::load_test(const vector<string>& args){
+  int clients = 1, games = 64, batch = 256;
+  double seconds = 3;
+  string name = DEFAULT_NAME;
+  for(size_t i = 0; i < args.size(); i++){
+    bool has_value = i + 1 < args.size();
+    if(args[i] == "--clients" && has_value)
+      clients = std::atoi(args[++i].c_str());
+    else if(args[i] == "--games" && has_value)
+      games = std::atoi(args[++i].c_str());
+    else if(args[i] == "--batch" && has_value)
+      batch = std::atoi(args[++i].c_str());
+    else if(args[i] == "--seconds" && has_value)
+      seconds = std::atof(args[++i].c_str());
+    else
+      name = args[i];
+  }
+  if(clients < 1 || games < 1 || batch < 1 || batch > (int)SERVICE_RING){
+    std::cerr << "Usage: play loadtest [--clients N] [--games N] [--batch N<=" << SERVICE_RING
+	      << "] [--seconds N] [NAME]\n";
+    return 1;
+  }
+
+  vector<long> answered(clients, 0), rejected(clients, 0);
+  vector<std::thread> threads;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for(int c = 0; c < clients; c++)
+    threads.push_back(std::thread([&, c](){
+	  answered[c] = load_client(name, games, batch, seconds, 2463534242u + c, rejected[c]);
+	}));
+  for(size_t t = 0; t < threads.size(); t++)
+    threads[t].join();
+  double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  long total = 0, total_rejected = 0;
+  for(int c = 0; c < clients; c++){
+    if(answered[c] < 0){
+      std::cerr << "Client " << c << " could not connect to " << name << "\n";
+      return 1;
+    }
+    total += answered[c];
+    total_rejected += rejected[c];
+  }
+  std::cout << "queries " << total << " time " << elapsed << "s clients " << clients
+	    << " batch " << batch << " qps " << (long)(total / elapsed)
+	    << " rejected moves " << total_rejected << "\n";
+  return total_rejected == 0 ? 0 : 1;
+}
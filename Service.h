@@ -0,0 +1,195 @@
+#ifndef SERVICE_H
+#define SERVICE_H
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include "BoardState.h"
+
+// Query service over POSIX shared memory. The daemon (play serve) creates
+// a region holding a table of games, as BoardStates, and one pair of
+// rings per client: requests from the client to the server and responses
+// back. Each ring has a single producer and a single consumer, so the
+// two sides only exchange atomic indices. A client writes a batch of
+// requests straight into its ring and publishes them with one store, and
+// reads the responses where the server wrote them. Nothing is copied
+// through the kernel and no system call is made while there is work.
+
+class ChessGame;
+
+// What a request asks for. A request naming a game that is not in use
+// gets status LOAD_FAILURE.
+enum ServiceOp {
+    SERVICE_NEW = 1,  // start a game of request.variant; response.game is its id
+    SERVICE_FREE,     // end a game
+    SERVICE_VALIDATE, // status the move from request.from to request.to would get
+    SERVICE_APPLY,    // play the move as a whole turn and return its status
+    SERVICE_STATUS    // outcome() of the game, 0 while it goes on
+};
+
+struct ServiceRequest {
+    uint16_t op;      // ServiceOp
+    uint16_t variant; // GameName, for SERVICE_NEW
+    uint32_t game;    // game id
+    int16_t from, to; // 1D board indices of a move
+    uint32_t tag;     // copied into the response
+};
+
+struct ServiceResponse {
+    int32_t status;   // status code, or the outcome for SERVICE_STATUS
+    uint32_t game;    // game id
+    int32_t to_move;  // player to move after the request
+    uint32_t tag;     // tag of the request
+};
+
+// Requests or responses in flight per client; a power of two
+const uint32_t SERVICE_RING = 1024;
+
+// Shared memory layout. Indices only ever grow; slot = index % SERVICE_RING.
+// Each index is written by one side only and sits on its own cache line.
+struct alignas(64) ServiceIndex {
+    std::atomic<uint32_t> value;
+};
+
+struct ServiceRing {
+    std::atomic<uint32_t> claimed;   // pid of the client that owns the ring, 0 if free
+    ServiceIndex requests_written;   // by the client
+    ServiceIndex requests_read;      // by the server
+    ServiceIndex responses_written;  // by the server
+    ServiceIndex responses_read;     // by the client
+    ServiceRequest requests[SERVICE_RING];
+    ServiceResponse responses[SERVICE_RING];
+};
+
+// A game in the table. The server bumps sequence to odd before changing
+// state and back to even after, so readers can tell a torn copy.
+struct ServiceGame {
+    std::atomic<uint32_t> sequence;
+    int32_t variant;  // GameName, 0 for a free slot
+    int32_t outcome;  // outcome() of the game, kept up to date by the server
+    BoardState state;
+};
+
+struct ServiceHeader {
+    char magic[4];                 // "CGSV"
+    uint32_t clients;              // number of rings
+    uint32_t games;                // number of game slots
+    std::atomic<uint32_t> running; // cleared when the server stops
+};
+
+
+// The daemon: owns the region, and answers every client from one thread,
+// so games need no locks even when several clients share them.
+class ServiceServer {
+
+public:
+
+    ServiceServer();
+
+    // Unmaps and removes the region
+    ~ServiceServer();
+
+    ServiceServer(const ServiceServer&) = delete;
+    ServiceServer& operator=(const ServiceServer&) = delete;
+
+    // Create the region called name (e.g. "/chessgame") for the given
+    // number of clients and games. Returns false if it can't be created.
+    bool create(const std::string& name, int clients, int games);
+
+    // Answer requests until stop is set. A ring's requests wait while its
+    // client has SERVICE_RING responses it hasn't read yet.
+    void serve(const std::atomic<bool>& stop);
+
+    // Command-line entry: play serve [--clients N] [--games N] [NAME]
+    static int main(const std::vector<std::string>& args);
+
+private:
+
+    std::string _name;
+    int _fd;
+    void* _map;
+    size_t _size;
+    ServiceHeader* _header;
+    ServiceRing* _rings;
+    ServiceGame* _games;
+    std::vector<uint32_t> _free;    // game slots not in use
+
+    // One game of each variant (indexed by GameName) that table entries are
+    // imported into to be worked on, the entry each holds, and the
+    // position each variant starts from
+    ChessGame* _scratch[4];
+    uint32_t _loaded[4];
+    BoardState _start[4];
+
+    // Answer one request
+    void handle(const ServiceRequest& request, ServiceResponse& response);
+
+    // Return the scratch game holding table entry id, importing it if needed
+    ChessGame* load(uint32_t id);
+
+    // Copy the scratch game's position back into table entry id
+    void store(uint32_t id, ChessGame& game);
+
+    // Free the rings of clients whose process has died, dropping what they left
+    void reclaim();
+
+};
+
+
+// One client connection: a claimed ring in a running server's region
+class ServiceClient {
+
+public:
+
+    ServiceClient() : _fd(-1), _map(nullptr), _size(0), _ring(nullptr) {}
+
+    // Gives the ring back
+    ~ServiceClient();
+
+    ServiceClient(const ServiceClient&) = delete;
+    ServiceClient& operator=(const ServiceClient&) = delete;
+
+    // Map the region called name and claim a free ring. Returns false if
+    // there is no server or every ring is taken.
+    bool connect(const std::string& name);
+
+    // Return the next request slot to fill in place, or nullptr if
+    // SERVICE_RING requests are already waiting for their responses
+    ServiceRequest* reserve();
+
+    // Hand every reserved request to the server
+    void publish();
+
+    // Wait until a response is ready and return how many are, with first
+    // pointing at the oldest. They are read in place, at most to the end
+    // of the ring, and stay valid until release. Returns 0 if the server
+    // has stopped.
+    int wait(const ServiceResponse*& first);
+
+    // Give back the oldest count responses
+    void release(int count);
+
+    // Copy a game's position out of the table. Returns false if it is not
+    // in use, or if the server stopped or died in the middle of writing it.
+    bool read_game(uint32_t game, BoardState& state) const;
+
+    // Command-line entry: play loadtest [--clients N] [--games N]
+    // [--batch N] [--seconds N] [NAME]. Moves are drawn from each game's
+    // legal moves, played along on a copy of it.
+    static int load_test(const std::vector<std::string>& args);
+
+private:
+
+    int _fd;
+    void* _map;
+    size_t _size;
+    ServiceHeader* _header;
+    ServiceRing* _ring;
+    ServiceGame* _games;
+    uint32_t _written;   // requests reserved so far
+    uint32_t _received;  // responses released so far
+
+};
+
+#endif // SERVICE_H
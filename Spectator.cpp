@@ -0,0 +1,192 @@
+#include <iostream>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+#include "ChessGame.h"
+#include "Variants.h"
+#include "Prompts.h"
+#include "Spectator.h"
+
+using std::string;
+using std::vector;
+
+// Squares past the end of a smaller board are never compared
+SpectatorFrame::SpectatorFrame(uint32_t sequence, const BoardState& before, const BoardState& after){
+  _bytes.reserve(7 + 2 * 4); //a move, a capture and a ghost's landing at most, usually
+  for(int shift = 0; shift < 32; shift += 8)
+    _bytes.push_back((uint8_t)(sequence >> shift));
+  _bytes.push_back((uint8_t)after.turn);
+  _bytes.push_back((uint8_t)(after.turn >> 8));
+  _bytes.push_back(0);
+  int squares = std::min((int)after.width * after.height, (int)BoardState::SQUARES);
+  for(int i = 0; i < squares; i++){
+    if(before.squares[i] != after.squares[i]){
+      _bytes.push_back((uint8_t)i);
+      _bytes.push_back((uint8_t)after.squares[i]);
+      _bytes[6]++;
+    }
+  }
+}
+
+uint32_t SpectatorFrame::sequence() const{
+  return _bytes[0] | (_bytes[1] << 8) | (_bytes[2] << 16) | ((uint32_t)_bytes[3] << 24);
+}
+
+int SpectatorFrame::turn() const{
+  return _bytes[4] | (_bytes[5] << 8);
+}
+
+void SpectatorFrame::apply(BoardState& state) const{
+  state.turn = turn();
+  for(size_t i = 7; i + 1 < _bytes.size(); i += 2)
+    state.squares[_bytes[i]] = (int8_t)_bytes[i + 1];
+}
+
+
+void SpectatorBoard::join(const BoardState& state, uint32_t sequence){
+  _state = state;
+  _sequence = sequence;
+  _synced = true;
+  _last.reset();
+}
+
+void SpectatorBoard::receive(const std::shared_ptr<const SpectatorFrame>& frame){
+  if(frame->sequence() != _sequence + 1)
+    _synced = false; //a missed turn: only a new join can help
+  _sequence = frame->sequence();
+  if(_synced)
+    frame->apply(_state);
+  _last = frame;
+}
+
+
+bool SpectatorStream::open(const string& path){
+  _file.open(path, std::ios::binary | std::ios::trunc);
+  return _file.is_open();
+}
+
+void SpectatorStream::join(const BoardState& state, uint32_t sequence){
+  BoardState empty = state;
+  for(int i = 0; i < BoardState::SQUARES; i++)
+    empty.squares[i] = BoardState::EMPTY;
+  write(SpectatorFrame(sequence, empty, state));
+}
+
+void SpectatorStream::receive(const std::shared_ptr<const SpectatorFrame>& frame){
+  write(*frame);
+}
+
+// Flushed at once, since the reader is waiting for it
+void SpectatorStream::write(const SpectatorFrame& frame){
+  _file.write(reinterpret_cast<const char*>(frame.data()), frame.size());
+  _file.flush();
+}
+
+
+SpectatorChannel::SpectatorChannel(const ChessGame& game) : _sequence(0), _bytes(0) {
+  game.export_state(_last);
+}
+
+void SpectatorChannel::subscribe(Spectator* spectator){
+  std::lock_guard<std::mutex> guard(_lock);
+  spectator->join(_last, _sequence);
+  _spectators.push_back(spectator);
+}
+
+void SpectatorChannel::unsubscribe(Spectator* spectator){
+  std::lock_guard<std::mutex> guard(_lock);
+  _spectators.erase(std::remove(_spectators.begin(), _spectators.end(), spectator), _spectators.end());
+}
+
+size_t SpectatorChannel::size() const{
+  std::lock_guard<std::mutex> guard(_lock);
+  return _spectators.size();
+}
+
+// One frame, whatever the number of spectators: each gets a reference to it
+void SpectatorChannel::publish(const ChessGame& game){
+  BoardState now;
+  game.export_state(now);
+  std::lock_guard<std::mutex> guard(_lock);
+  std::shared_ptr<const SpectatorFrame> frame =
+    std::make_shared<const SpectatorFrame>(_sequence + 1, _last, now);
+  if(frame->changes() == 0 && frame->turn() == _last.turn)
+    return;
+  _sequence++;
+  _bytes += frame->size();
+  _last = now;
+  for(size_t i = 0; i < _spectators.size(); i++)
+    _spectators[i]->receive(frame);
+}
+
+// Play random turns in one game watched by many boards, timing only the
+// publishing, then check every board against the game
+int SpectatorChannel::main(const vector<string>& args){
+  int subscribers = 10000, plies = 200;
+  uint64_t seed = 1;
+  vector<string> positional;
+  for(size_t i = 0; i < args.size(); i++){
+    bool has_value = i + 1 < args.size();
+    if(args[i] == "--subscribers" && has_value)
+      subscribers = std::atoi(args[++i].c_str());
+    else if(args[i] == "--plies" && has_value)
+      plies = std::atoi(args[++i].c_str());
+    else if(args[i] == "--seed" && has_value)
+      seed = std::strtoull(args[++i].c_str(), nullptr, 10);
+    else
+      positional.push_back(args[i]);
+  }
+  if(positional.size() != 1 || subscribers < 1 || plies < 1){
+    std::cerr << "Usage: play fanout [--subscribers N] [--plies N] [--seed N] <game>\n";
+    return 1;
+  }
+  ChessGame* game = nullptr;
+  try {
+    game = create_game(std::atoi(positional[0].c_str()), "");
+  }
+  catch(std::exception& e){
+    Prompts::load_failure();
+    return 1;
+  }
+  if(game == nullptr){
+    std::cerr << "Usage: play fanout [--subscribers N] [--plies N] [--seed N] <game>\n";
+    return 1;
+  }
+
+  SpectatorChannel channel(*game);
+  vector<SpectatorBoard> boards(subscribers);
+  for(size_t i = 0; i < boards.size(); i++)
+    channel.subscribe(&boards[i]);
+
+  uint64_t random = seed * 0x9e3779b97f4a7c15ULL | 1; //xorshift64, as in selfplay
+  double seconds = 0;
+  int played = 0;
+  for(; played < plies && game->outcome() == 0; played++){
+    MoveList moves;
+    game->legal_moves(moves);
+    random ^= random << 13;
+    random ^= random >> 7;
+    random ^= random << 17;
+    game->play_turn(moves[random % moves.size()]);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    channel.publish(*game);
+    seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  }
+
+  BoardState final_state;
+  game->export_state(final_state);
+  int synced = 0;
+  for(size_t i = 0; i < boards.size(); i++){
+    if(boards[i].synced() && boards[i].state().turn == final_state.turn &&
+       std::equal(final_state.squares, final_state.squares + BoardState::SQUARES, boards[i].state().squares))
+      synced++;
+  }
+  double deliveries = (double)played * subscribers;
+  std::cout << "plies " << played << " subscribers " << subscribers << " time " << seconds << "s"
+	    << " ns/delivery " << (deliveries > 0 ? seconds * 1e9 / deliveries : 0)
+	    << " us/turn " << (played > 0 ? seconds * 1e6 / played : 0)
+	    << " bytes/frame " << (channel.sequence() > 0 ? (double)channel.bytes() / channel.sequence() : 0)
+	    << " in sync " << synced << "/" << subscribers << "\n";
+  delete game;
+  return synced == subscribers ? 0 : 1;
+}
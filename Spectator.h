@@ -0,0 +1,160 @@
+#ifndef SPECTATOR_H
+#define SPECTATOR_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <mutex>
+#include <cstdint>
+#include "BoardState.h"
+
+class ChessGame;
+
+// One turn of a game as the squares it changed: the moved piece, a
+// capture, a promotion, and in Spooky Chess the ghost and whatever it
+// took. The bytes are
+//     sequence (4 bytes, low byte first), turn (2 bytes), count,
+//     then count pairs of square and new piece code (BoardState::code)
+// so a quiet move is 11 bytes. A frame is built once per turn and then
+// only read, so every spectator shares the same one.
+class SpectatorFrame {
+
+public:
+
+    // Encode the change from before to after, numbered sequence
+    SpectatorFrame(uint32_t sequence, const BoardState& before, const BoardState& after);
+
+    uint32_t sequence() const;
+    int turn() const;
+
+    // Number of changed squares
+    int changes() const { return _bytes[6]; }
+
+    const uint8_t* data() const { return _bytes.data(); }
+    size_t size() const { return _bytes.size(); }
+
+    // Change state the way the turn did
+    void apply(BoardState& state) const;
+
+private:
+
+    std::vector<uint8_t> _bytes;
+
+};
+
+
+// Someone watching a game through a SpectatorChannel
+class Spectator {
+
+public:
+
+    virtual ~Spectator() {}
+
+    // The position when the spectator subscribed. The next frame is sequence + 1.
+    virtual void join(const BoardState& state, uint32_t sequence) = 0;
+
+    // The frame of a turn. It may be kept after returning, but never changes.
+    virtual void receive(const std::shared_ptr<const SpectatorFrame>& frame) = 0;
+
+};
+
+
+// A spectator that keeps its own copy of the board up to date from the
+// frames, keeping the last frame the way a connection keeps what it has
+// yet to send
+class SpectatorBoard : public Spectator {
+
+public:
+
+    SpectatorBoard() : _sequence(0), _synced(false) {}
+
+    void join(const BoardState& state, uint32_t sequence) override;
+    void receive(const std::shared_ptr<const SpectatorFrame>& frame) override;
+
+    // The board as seen so far
+    const BoardState& state() const { return _state; }
+
+    // Return false once a frame went missing, until the next join
+    bool synced() const { return _synced; }
+
+private:
+
+    BoardState _state;
+    uint32_t _sequence;
+    bool _synced;
+    std::shared_ptr<const SpectatorFrame> _last;
+
+};
+
+
+// A spectator that writes the frames to a file as they come, for another
+// process to follow the game by reading it (play --spectate FILE). The
+// file starts with a frame that sets the position up from an empty board,
+// numbered like the join.
+class SpectatorStream : public Spectator {
+
+public:
+
+    // Open path for writing, emptying it. Returns false if it can't be.
+    bool open(const std::string& path);
+
+    bool is_open() const { return _file.is_open(); }
+
+    void join(const BoardState& state, uint32_t sequence) override;
+    void receive(const std::shared_ptr<const SpectatorFrame>& frame) override;
+
+private:
+
+    std::ofstream _file;
+
+    void write(const SpectatorFrame& frame);
+
+};
+
+
+// The spectators of one game. After every turn, publish compares the game
+// with the position last sent, encodes the difference as a single frame
+// and hands that frame to every spectator, so the cost per spectator is
+// one call and one reference count, however many squares changed. Since
+// frames are differences of whole positions, a takeback is sent like any
+// other turn.
+class SpectatorChannel {
+
+public:
+
+    // Start from the position of game
+    explicit SpectatorChannel(const ChessGame& game);
+
+    // Add a spectator (not owned), which is first sent the current position
+    void subscribe(Spectator* spectator);
+
+    // Remove a spectator; it gets nothing more once this returns
+    void unsubscribe(Spectator* spectator);
+
+    // Send what changed in game since the last call, if anything did
+    void publish(const ChessGame& game);
+
+    // Number of spectators
+    size_t size() const;
+
+    // Frames sent so far. This and bytes are for the thread that publishes.
+    uint32_t sequence() const { return _sequence; }
+
+    // Size of those frames together, each counted once
+    uint64_t bytes() const { return _bytes; }
+
+    // Command-line entry: play fanout [--subscribers N] [--plies N] [--seed N] <game>
+    static int main(const std::vector<std::string>& args);
+
+private:
+
+    mutable std::mutex _lock;   // guards everything below
+    std::vector<Spectator*> _spectators;
+    BoardState _last;           // the position spectators have
+    uint32_t _sequence;
+    uint64_t _bytes;
+
+};
+
+#endif // SPECTATOR_H
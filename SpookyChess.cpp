@@ -13,6 +13,7 @@
 #include "ChessGame.h"
 #include "SpookyChess.h"
 #include "Prompts.h"
+#include "Timeline.h"
 
 using std::string;
 using std::ifstream;
@@ -35,7 +36,7 @@ SpookyChess::SpookyChess() : ChessGame(){
   init_piece(GHOST_ENUM, NO_ONE, Position(0,4));
   
   //seed random number generator
-  srand(322);
+  _random.seed(322);
 
   //initalize number of times number generator has been called
   num_calls = 0;
@@ -47,7 +48,7 @@ SpookyChess::SpookyChess(std::string filename, int type) : ChessGame(filename, t
    //add Ghost piece factory
    add_factory(new PieceFactory<Ghost>(GHOST_ENUM));
    //seed random number generator
-   srand(322);
+   _random.seed(322);
    //filestream to read in from file
    ifstream file(filename);
    string game; //used to store game choice
@@ -56,18 +57,25 @@ SpookyChess::SpookyChess(std::string filename, int type) : ChessGame(filename, t
      throw std::logic_error("Wrong Game");
    file >> _turn;
    file >> num_calls;
-   // call rand function correct number of times to restore state
+   // draw the correct number of random numbers to restore state
    for(int i = 0; i < num_calls; ++i){
-     rand();
+     _random.next();
    }
    load_pieces(file);//load pieces
-   for(int i = 0;  i < 64; ++i){//initalize ghost position
+   for(int i = 0;  i < (int)_pieces.size(); ++i){//initalize ghost position
      if(_pieces[i] != nullptr && _pieces[i]->owner() == NO_ONE){
        ghost_position = i;
      }
    }    
 }
 
+// Copy another game. The ghost factory is registered again, so that a copy
+// of this copy can make its own ghost too.
+SpookyChess::SpookyChess(const SpookyChess& other) :
+  ChessGame(other), ghost_position(other.ghost_position), num_calls(other.num_calls), _random(other._random) {
+  add_factory(new PieceFactory<Ghost>(GHOST_ENUM));
+}
+
 // Update board and make move for spooky chess, calls try_move() of ChessGame
 int SpookyChess::update_board(string input){
   int status = try_move(input);
@@ -89,38 +97,132 @@ int SpookyChess::update_board(string input){
 }
 
 
+int SpookyChess::play_turn(Move m){
+  int status = ChessGame::play_turn(m);
+  if(status > 0 && move_ghost_piece() == GHOST_CAPTURE)
+    return GHOST_CAPTURE;
+  return status;
+}
+
+int SpookyChess::play_checked_turn(Move m, int status){
+  ChessGame::play_checked_turn(m, status);
+  if(move_ghost_piece() == GHOST_CAPTURE)
+    return GHOST_CAPTURE;
+  return status;
+}
+
 // Moves the ghost piece and return whether the ghost has performed a capture
 int SpookyChess::move_ghost_piece(){
   int status = SUCCESS; //used to tell if the ghost has captured a piece
+  int draws = 0; //random numbers used for this move
   while(true){
-    int end = std::rand()%64;
+    int end = _random.next()%(int)_pieces.size(); //any square of the board
     num_calls++;
+    draws++;
 
-    //generate pointer to ghost piece
-    Piece* g = _pieces[ghost_position];
-    
     //check if king is at selected position
     //jumps back to the beginning of loop if true
     if(_pieces[end] != nullptr && _pieces[end]->piece_type()== KING_ENUM)continue;
     
-    if(_pieces[end] == nullptr){//if no piece is at the end position
-      _pieces[ghost_position] = nullptr; //remove ghost piece from starting pos
-      _pieces[end] = g;
-    }
-    else{//if piece exists at end position
-      _pieces[ghost_position] = nullptr; //remove ghost piece from previous position
-      delete _pieces[end]; //memory clean up for removed piece
-      _pieces[end] = g;
+    //a landing on the ghost's own square is reported as a capture, as it always has been
+    if(_pieces[end] != nullptr)
       status = GHOST_CAPTURE;
-    }
-    //update ghost position
-    ghost_position = end;
+    int from = ghost_position;
+    Piece* captured = place_ghost(end);
+    if(captured != nullptr)
+      _halfmove = 0; //a capture can't be repeated
+    if(_journal != nullptr)
+      _journal->record_ghost(from, end, draws);
+    if(_timeline != nullptr)
+      _timeline->record_ghost(from, end, draws);
     break;
   }
   return status;
   
 }
 
+// Replay a journaled ghost move: use up the same random numbers, then land where it did
+void SpookyChess::replay_ghost(int square, int draws){
+  for(int i = 0; i < draws; ++i)
+    _random.next();
+  num_calls += draws;
+  if(square < 0 || square >= (int)_pieces.size())
+    return;
+  Piece* captured = place_ghost(square);
+  if(captured != nullptr)
+    _halfmove = 0;
+}
+
+void SpookyChess::export_state(BoardState& state) const {
+  ChessGame::export_state(state);
+  state.ghost_position = ghost_position;
+  state.num_calls = num_calls;
+  state.random = _random;
+}
+
+bool SpookyChess::import_state(const BoardState& state){
+  if(!ChessGame::import_state(state))
+    return false;
+  ghost_position = state.ghost_position;
+  num_calls = state.num_calls;
+  _random = state.random;
+  return true;
+}
+
+// Move the ghost onto square, handing back whatever piece was standing there
+Piece* SpookyChess::place_ghost(int square){
+  Piece* g = _pieces[ghost_position]; //generate pointer to ghost piece
+  _pieces[ghost_position] = nullptr; //remove ghost piece from previous position
+  Piece* captured = _pieces[square];
+  _pieces[square] = g;
+  toggle_hash(g, ghost_position);
+  toggle_hash(captured, square);
+  toggle_hash(g, square);
+  remove_material(captured);
+  ghost_position = square; //update ghost position
+  return captured;
+}
+
+// Take back place_ghost: the ghost returns to from and captured reappears
+void SpookyChess::unplace_ghost(int from, Piece* captured){
+  Piece* g = _pieces[ghost_position];
+  _pieces[ghost_position] = captured;
+  _pieces[from] = g;
+  toggle_hash(g, ghost_position);
+  toggle_hash(captured, ghost_position);
+  toggle_hash(g, from);
+  add_material(captured);
+  ghost_position = from;
+}
+
+// List the ghost's landings for the engine. Each capture changes the material
+// differently, so it gets its own outcome, while the quiet landings (including
+// staying put) only move a blocker around and are split into a few contiguous
+// groups, each represented by its middle square.
+int SpookyChess::ghost_outcomes(vector<GhostOutcome>& outcomes, int empty_groups) const{
+  outcomes.clear();
+  vector<int> quiet; //landings that capture nothing
+  for(int i = 0; i < (int)_pieces.size(); ++i){
+    if(_pieces[i] == nullptr || i == ghost_position)
+      quiet.push_back(i);
+    else if(_pieces[i]->piece_type() != KING_ENUM){
+      GhostOutcome capture = {i, 1};
+      outcomes.push_back(capture);
+    }
+  }
+  int total = outcomes.size() + quiet.size();
+  if(empty_groups < 1)
+    empty_groups = 1;
+  int groups = (int)quiet.size() < empty_groups ? quiet.size() : empty_groups;
+  for(int g = 0; g < groups; ++g){
+    int first = quiet.size() * g / groups;
+    int last = quiet.size() * (g + 1) / groups;
+    GhostOutcome landing = {quiet[(first + last) / 2], last - first};
+    outcomes.push_back(landing);
+  }
+  return total;
+}
+
 void SpookyChess::save_game(){
   //Ask user for filename to save
   Prompts::save_game();
@@ -137,5 +239,6 @@ void SpookyChess::save_game(){
   file << num_calls << endl; //save the number of times number generator was called
   save_piece_state(file);
   file.close();
+  snapshot_saved(name);
   Prompts::save_success();
 }
@@ -2,8 +2,16 @@
 #define SPOOKYCHESS_H
 
 #include <string>
+#include <vector>
 #include "ChessGame.h"
 
+// A set of equally likely ghost landings that the engine treats as one outcome.
+// square is the representative landing and weight the number of landings it stands for.
+struct GhostOutcome {
+    int square;
+    int weight;
+};
+
 class SpookyChess : public ChessGame {
 
 public:
@@ -14,18 +22,58 @@ public:
     // Creates game with state indicated in specified file
     SpookyChess(std::string filename, int type);
 
+    // Creates an independent copy of another game, ghost included
+    SpookyChess(const SpookyChess& other);
+
     // perform main gameplay loop for SpookyChess
     int update_board(std::string input) override;
 
     //move ghost piece to new random position
     int move_ghost_piece();
 
+    // Play the move, then move the ghost if the move was made. Returns
+    // GHOST_CAPTURE if the ghost took a piece, else the move's status.
+    int play_turn(Move m) override;
+    int play_checked_turn(Move m, int status) override;
+
+    // Replay a journaled ghost move that landed on square after draws random numbers
+    void replay_ghost(int square, int draws);
+
+    // Return the 1D index of the ghost on the board
+    int ghost_square() const { return ghost_position; }
+
+    // Put the ghost on square, returning the piece it captured (nullptr if none).
+    // The captured piece is not deleted, so unplace_ghost can restore it.
+    Piece* place_ghost(int square);
+
+    // Move the ghost back to from, returning captured to the square it left
+    void unplace_ghost(int from, Piece* captured);
+
+    // Fill outcomes with the landings move_ghost_piece can pick, all equally likely.
+    // Every capture is its own outcome; quiet landings are grouped into at most
+    // empty_groups outcomes. Returns the total weight of all outcomes.
+    int ghost_outcomes(std::vector<GhostOutcome>& outcomes, int empty_groups) const;
+
+    // Only bare kings: the ghost blocks squares, so it can help a lone
+    // minor piece mate
+    bool insufficient_material() const override { return _material == Material::bare_kings(); }
+
     //saves current state of game
     void save_game() override;
 
+    // Return a new copy of this game. Caller owns the result.
+    ChessGame* clone() const override { return new SpookyChess(*this); }
+
+    // Add the ghost and its random number sequence to the exported state
+    void export_state(BoardState& state) const override;
+
+    // Restore the ghost and its random number sequence along with the board
+    bool import_state(const BoardState& state) override;
+
 protected:
     int ghost_position; //1D index indicating location of the ghost on board
-    int num_calls; //number of times rand() has been called
+    int num_calls; //number of random numbers drawn for the ghost
+    GhostRandom _random; //random numbers for the ghost, seeded the same way every game
 
 };
 
@@ -0,0 +1,103 @@
+#include <thread>
+#include <mutex>
+#include "ThreadPool.h"
+
+// Index of the worker running on this thread, -1 outside the pool
+static thread_local int current_worker = -1;
+static thread_local const ThreadPool* current_pool = nullptr;
+
+ThreadPool::ThreadPool(int threads) : _queued(0), _unfinished(0), _next(0), _stopping(false) {
+  if(threads < 1)
+    threads = 1;
+  for(int i = 0; i < threads; i++)
+    _queues.push_back(new Queue());
+  for(int i = 0; i < threads; i++)
+    _workers.push_back(std::thread(&ThreadPool::work, this, i));
+}
+
+ThreadPool::~ThreadPool() {
+  wait();
+  {
+    std::lock_guard<std::mutex> guard(_lock);
+    _stopping = true;
+  }
+  _work.notify_all();
+  for(size_t i = 0; i < _workers.size(); i++)
+    _workers[i].join();
+  for(size_t i = 0; i < _queues.size(); i++)
+    delete _queues[i];
+}
+
+int ThreadPool::hardware_threads() {
+  unsigned int n = std::thread::hardware_concurrency();
+  return n > 0 ? n : 1;
+}
+
+void ThreadPool::submit(const Task& task) {
+  {
+    std::lock_guard<std::mutex> guard(_lock);
+    int target = (current_pool == this) ? current_worker : _next++ % _queues.size();
+    std::lock_guard<std::mutex> queue_guard(_queues[target]->lock);
+    _queues[target]->tasks.push_back(task);
+    _queued++;
+    _unfinished++;
+  }
+  _work.notify_one();
+}
+
+void ThreadPool::wait() {
+  std::unique_lock<std::mutex> guard(_lock);
+  _done.wait(guard, [this]{ return _unfinished == 0; });
+}
+
+// Newest task of our own queue keeps related work together; the oldest task
+// of a victim's queue is the biggest piece left to steal
+bool ThreadPool::take(int id, Task& task) {
+  {
+    Queue& own = *_queues[id];
+    std::lock_guard<std::mutex> guard(own.lock);
+    if(!own.tasks.empty()){
+      task = own.tasks.back();
+      own.tasks.pop_back();
+      return true;
+    }
+  }
+  for(size_t i = 1; i < _queues.size(); i++){
+    Queue& victim = *_queues[(id + i) % _queues.size()];
+    std::lock_guard<std::mutex> guard(victim.lock);
+    if(!victim.tasks.empty()){
+      task = victim.tasks.front();
+      victim.tasks.pop_front();
+      return true;
+    }
+  }
+  return false;
+}
+
+void ThreadPool::work(int id) {
+  current_worker = id;
+  current_pool = this;
+  while(true){
+    {
+      std::unique_lock<std::mutex> guard(_lock);
+      _work.wait(guard, [this]{ return _queued > 0 || _stopping; });
+      if(_queued == 0 && _stopping)
+	return;
+    }
+    Task task;
+    if(!take(id, task))
+      continue; //another worker got there first
+    {
+      std::lock_guard<std::mutex> guard(_lock);
+      _queued--;
+    }
+    task(id);
+    bool idle;
+    {
+      std::lock_guard<std::mutex> guard(_lock);
+      idle = (--_unfinished == 0);
+    }
+    if(idle)
+      _done.notify_all();
+  }
+}
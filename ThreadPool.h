@@ -0,0 +1,72 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+// A fixed set of worker threads sharing work by stealing. Every worker has
+// its own queue: it takes its newest task first and, once its queue is
+// empty, takes the oldest task from another worker. Tasks are told which
+// worker runs them so they can use per-worker state such as a private copy
+// of the game.
+class ThreadPool {
+
+public:
+
+    // A unit of work, called with the index of the worker running it
+    typedef std::function<void(int)> Task;
+
+    // Start the given number of workers (at least one)
+    explicit ThreadPool(int threads);
+
+    // Finish the queued work, then stop the workers
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Return the number of workers
+    int size() const { return _queues.size(); }
+
+    // Queue a task. Tasks submitted from a worker go to that worker's queue,
+    // others are dealt round robin.
+    void submit(const Task& task);
+
+    // Block until every submitted task has finished
+    void wait();
+
+    // Return the number of hardware threads, at least 1
+    static int hardware_threads();
+
+private:
+
+    // One worker's queue of tasks
+    struct Queue {
+        std::mutex lock;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<Queue*> _queues;
+    std::vector<std::thread> _workers;
+
+    std::mutex _lock;                 // guards the counters below
+    std::condition_variable _work;    // signalled when a task is queued or on shutdown
+    std::condition_variable _done;    // signalled when the pool becomes idle
+    int _queued;                      // tasks waiting in queues
+    int _unfinished;                  // tasks queued or running
+    unsigned int _next;               // round robin queue for outside submissions
+    bool _stopping;
+
+    // Take a task for worker id: own queue first, then steal
+    bool take(int id, Task& task);
+
+    // Body of each worker thread
+    void work(int id);
+
+};
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,79 @@
+#include <algorithm>
+#include "ChessGame.h"
+#include "SpookyChess.h"
+#include "Timeline.h"
+
+Timeline::Timeline(int interval) : _interval(std::max(1, interval)), _plies(0) {}
+
+void Timeline::start(const ChessGame& game){
+  _plies = 0;
+  _records.clear();
+  _snapshots.clear();
+  checkpoint(game);
+}
+
+// A snapshot is due once per interval plies. Moves tried and refused call
+// this again from the same position, which then has its snapshot already.
+void Timeline::checkpoint(const ChessGame& game){
+  if(_plies != (int)_snapshots.size() * _interval)
+    return;
+  _snapshots.emplace_back();
+  _snapshots.back().record = _records.size();
+  game.export_state(_snapshots.back().state);
+}
+
+void Timeline::record_move(Move m){
+  _records.push_back(m.bits());
+  _plies++;
+}
+
+// Split like Journal::record_ghost, draws only getting 6 bits
+void Timeline::record_ghost(int from, int square, int draws){
+  for(; draws > 63; draws -= 63)
+    _records.push_back(Move(from, 63, Move::GHOST).bits());
+  _records.push_back(Move(square, draws, Move::GHOST).bits());
+}
+
+// A move's ghost landings follow it, so move number ply starts at the
+// ply-th record after the snapshot that is not a ghost's
+size_t Timeline::find(int ply, int& snapshot) const{
+  snapshot = std::min(ply / _interval, (int)_snapshots.size() - 1);
+  int moves = ply - snapshot * _interval;
+  for(size_t i = _snapshots[snapshot].record; i < _records.size(); i++){
+    if(Move::from_bits(_records[i]).is(Move::GHOST))
+      continue;
+    if(moves-- == 0)
+      return i;
+  }
+  return _records.size();
+}
+
+bool Timeline::seek(ChessGame& game, int ply) const{
+  if(ply < 0 || ply > _plies || _snapshots.empty())
+    return false;
+  int snapshot;
+  size_t end = find(ply, snapshot);
+  if(!game.import_state(_snapshots[snapshot].state))
+    return false;
+  SpookyChess* spooky = dynamic_cast<SpookyChess*>(&game);
+  for(size_t i = _snapshots[snapshot].record; i < end; i++){
+    Move m = Move::from_bits(_records[i]);
+    if(m.is(Move::GHOST)){
+      if(spooky != nullptr)
+	spooky->replay_ghost(m.from(), m.to());
+    }
+    else if(game.replay_move(m) < 0)
+      return false;
+  }
+  return true;
+}
+
+// The snapshot of ply itself is kept: it is the position before the next move
+void Timeline::truncate(int ply){
+  if(ply < 0 || ply >= _plies || _snapshots.empty())
+    return;
+  int snapshot;
+  _records.resize(find(ply, snapshot));
+  _snapshots.resize(std::min(_snapshots.size(), (size_t)(ply / _interval + 1)));
+  _plies = ply;
+}
@@ -0,0 +1,71 @@
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "Move.h"
+#include "BoardState.h"
+
+class ChessGame;
+
+// The moves of a game in memory, for going back to any earlier position.
+// Moves are kept as 16-bit records the way Journal writes them, ghost
+// landings in Spooky Chess included, and every interval plies the whole
+// position is kept as a BoardState. seek() restores the snapshot at or
+// before the wanted ply and replays at most interval moves from it, so
+// takebacks and reviews cost the same early or late in a long game.
+class Timeline {
+
+public:
+
+    // Plies between snapshots when none is given
+    static const int DEFAULT_INTERVAL = 16;
+
+    explicit Timeline(int interval = DEFAULT_INTERVAL);
+
+    // Start over with the position of game as ply 0
+    void start(const ChessGame& game);
+
+    // Called by make_move before a move is tried, with the position it is
+    // tried from: keeps a snapshot of game if one is due
+    void checkpoint(const ChessGame& game);
+
+    // Append a player's move
+    void record_move(Move m);
+
+    // Append where the ghost, standing on from, landed and how many random numbers it took
+    void record_ghost(int from, int square, int draws);
+
+    // Number of moves recorded
+    int plies() const { return _plies; }
+
+    // Put game, of the variant recorded, in the position after ply moves.
+    // The moves replayed go through make_move, so game must have no journal
+    // or timeline attached. Returns false if ply is out of range or the
+    // records don't replay on game.
+    bool seek(ChessGame& game, int ply) const;
+
+    // Forget every move after the first ply
+    void truncate(int ply);
+
+private:
+
+    // The position before move number interval * i, for i its index in _snapshots
+    struct Snapshot {
+        size_t record;     // index in _records of that move
+        BoardState state;
+    };
+
+    int _interval;
+    int _plies;
+    std::vector<uint16_t> _records;    // Move bits
+    std::vector<Snapshot> _snapshots;
+
+    // Index in _records of move number ply, _records.size() for ply == _plies.
+    // Also returns the index of the nearest snapshot before it.
+    size_t find(int ply, int& snapshot) const;
+
+};
+
+#endif // TIMELINE_H
@@ -0,0 +1,225 @@
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include "Game.h"
+#include "ChessGame.h"
+#include "Zobrist.h"
+#include "TrainingData.h"
+
+using std::string;
+using std::vector;
+
+static const char MAGIC[4] = {'C', 'G', 'T', 'D'};
+static const int VERSION = 1;
+
+// Buffers allowed to wait for the writer before add blocks
+static const size_t MAX_PENDING = 8;
+
+void pack_position(const ChessGame& game, int variant, int score, int ply, uint8_t* record){
+  BoardState state;
+  game.export_state(state);
+  memset(record, 0, RECORD_SIZE);
+  for(int i = 0; i < BoardState::SQUARES; i++){
+    int code = state.squares[i];
+    int nibble = 0;
+    if(code != BoardState::EMPTY){
+      int type = code & 7, owner = code >> 3;
+      nibble = (owner == NO_ONE) ? 13 : 1 + owner * 6 + type;
+    }
+    record[i / 2] |= nibble << (4 * (i % 2));
+  }
+  if(score > 32767) score = 32767;
+  if(score < -32767) score = -32767;
+  int halfmove = state.halfmove > 255 ? 255 : state.halfmove;
+  record[32] = variant;
+  record[33] = game.player_turn();
+  record[34] = (uint16_t)score & 0xff;
+  record[35] = (uint16_t)score >> 8;
+  record[36] = 0;
+  record[37] = halfmove;
+  record[38] = ply & 0xff;
+  record[39] = (ply >> 8) & 0xff;
+}
+
+void set_result(uint8_t* record, int white_result){
+  int result = record[33] == WHITE ? white_result : -white_result;
+  record[36] = (uint8_t)(int8_t)result;
+}
+
+void unpack_position(const uint8_t* record, TrainingPosition& position){
+  for(int i = 0; i < BoardState::SQUARES; i++){
+    int nibble = (record[i / 2] >> (4 * (i % 2))) & 15;
+    if(nibble == 0)
+      position.squares[i] = BoardState::EMPTY;
+    else if(nibble == 13)
+      position.squares[i] = BoardState::code(GHOST_ENUM, NO_ONE);
+    else
+      position.squares[i] = BoardState::code((nibble - 1) % 6, (Player)((nibble - 1) / 6));
+  }
+  position.variant = record[32];
+  position.to_move = record[33];
+  position.score = (int16_t)(record[34] | record[35] << 8);
+  position.result = (int8_t)record[36];
+  position.halfmove = record[37];
+  position.ply = record[38] | record[39] << 8;
+}
+
+bool load_position(ChessGame& game, const TrainingPosition& position){
+  BoardState state;
+  game.export_state(state);
+  if(state.width * state.height != BoardState::SQUARES)
+    return false;
+  state.hash = state.pawn_hash = 0;
+  state.king_square[WHITE] = state.king_square[BLACK] = -1;
+  for(int i = 0; i < BoardState::SQUARES; i++){
+    int code = position.squares[i];
+    state.squares[i] = code;
+    if(code == BoardState::EMPTY)
+      continue;
+    int type = code & 7;
+    Player owner = (Player)(code >> 3);
+    uint64_t key = Zobrist::piece(type, owner, i);
+    state.hash ^= key;
+    if(type == PAWN_ENUM)
+      state.pawn_hash ^= key;
+    if(type == KING_ENUM)
+      state.king_square[owner] = i;
+    if(type == GHOST_ENUM)
+      state.ghost_position = i;
+  }
+  state.turn = position.to_move == WHITE ? 1 : 2;
+  state.halfmove = position.halfmove;
+  state.history_count = HISTORY_SIZE;
+  for(int i = 0; i < HISTORY_SIZE; i++)
+    state.history[i] = 0;
+  return game.import_state(state);
+}
+
+void training_header(uint8_t* out){
+  memcpy(out, MAGIC, sizeof MAGIC);
+  out[4] = VERSION & 0xff;
+  out[5] = VERSION >> 8;
+  out[6] = RECORD_SIZE & 0xff;
+  out[7] = RECORD_SIZE >> 8;
+}
+
+bool valid_training_header(const uint8_t* bytes){
+  uint8_t expected[TRAINING_HEADER_SIZE];
+  training_header(expected);
+  return memcmp(bytes, expected, TRAINING_HEADER_SIZE) == 0;
+}
+
+
+TrainingWriter::TrainingWriter() :
+  _shard_records(0), _shard(0), _in_shard(0), _fd(-1), _failed(false), _records(0), _closing(false) {}
+
+TrainingWriter::~TrainingWriter(){
+  close();
+}
+
+bool TrainingWriter::next_file(){
+  if(_fd >= 0)
+    ::close(_fd);
+  string name = _path;
+  if(_shard_records > 0){
+    char suffix[16];
+    snprintf(suffix, sizeof suffix, "-%03d.cgt", _shard);
+    name += suffix;
+  }
+  _shard++;
+  _in_shard = 0;
+  _fd = ::open(name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if(_fd < 0)
+    return false;
+  uint8_t header[TRAINING_HEADER_SIZE];
+  training_header(header);
+  return write(_fd, header, sizeof header) == (ssize_t)sizeof header;
+}
+
+bool TrainingWriter::open(const string& path, long shard_records){
+  close();
+  _path = path;
+  _shard_records = shard_records;
+  _shard = 0;
+  _records = 0;
+  _failed = false;
+  _closing = false;
+  if(!next_file()){
+    _failed = true;
+    return false;
+  }
+  _current.reserve((size_t)BUFFER_RECORDS * RECORD_SIZE);
+  _thread = std::thread(&TrainingWriter::write_loop, this);
+  return true;
+}
+
+void TrainingWriter::add(const uint8_t* records, int count){
+  std::unique_lock<std::mutex> guard(_lock);
+  _current.insert(_current.end(), records, records + (size_t)count * RECORD_SIZE);
+  _records += count;
+  if(_current.size() < (size_t)BUFFER_RECORDS * RECORD_SIZE)
+    return;
+  _space.wait(guard, [this](){ return _pending.size() < MAX_PENDING; });
+  _pending.push_back(vector<uint8_t>());
+  _pending.back().swap(_current);
+  _current.reserve((size_t)BUFFER_RECORDS * RECORD_SIZE);
+  _full.notify_one();
+}
+
+void TrainingWriter::write_loop(){
+  std::unique_lock<std::mutex> guard(_lock);
+  while(true){
+    _full.wait(guard, [this](){ return !_pending.empty() || _closing; });
+    if(_pending.empty())
+      return; //closing, and nothing left
+    vector<uint8_t> buffer;
+    buffer.swap(_pending.front());
+    _pending.pop_front();
+    _space.notify_all();
+    guard.unlock(); //producers go on while this is written
+    write_buffer(buffer);
+    guard.lock();
+  }
+}
+
+void TrainingWriter::write_buffer(const vector<uint8_t>& buffer){
+  size_t done = 0;
+  while(done < buffer.size() && !_failed){
+    size_t records = (buffer.size() - done) / RECORD_SIZE;
+    if(_shard_records > 0){
+      if(_in_shard >= _shard_records && !next_file()){
+	_failed = true;
+	return;
+      }
+      if((long)records > _shard_records - _in_shard)
+	records = _shard_records - _in_shard;
+    }
+    size_t bytes = records * RECORD_SIZE;
+    if(write(_fd, buffer.data() + done, bytes) != (ssize_t)bytes)
+      _failed = true;
+    done += bytes;
+    _in_shard += records;
+  }
+}
+
+bool TrainingWriter::close(){
+  if(!_thread.joinable())
+    return !_failed;
+  {
+    std::lock_guard<std::mutex> guard(_lock);
+    if(!_current.empty()){
+      _pending.push_back(vector<uint8_t>());
+      _pending.back().swap(_current);
+    }
+    _closing = true;
+  }
+  _full.notify_one();
+  _thread.join();
+  if(_fd >= 0)
+    ::close(_fd);
+  _fd = -1;
+  return !_failed;
+}
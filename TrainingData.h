@@ -0,0 +1,122 @@
+#ifndef TRAINING_DATA_H
+#define TRAINING_DATA_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include "BoardState.h"
+
+class ChessGame;
+
+// Labelled positions for tuning the evaluation, stored as fixed-size
+// records of RECORD_SIZE bytes after an 8-byte file header "CGTD" plus a
+// version and the record size (16-bit, low byte first):
+//   0-31  the 64 squares, two per byte, low nibble first: 0 empty,
+//         1-6 white pawn..king, 7-12 black pawn..king, 13 ghost
+//   32    variant (GameName)
+//   33    player to move
+//   34-35 search score in centipawns for the player to move
+//   36    final result for the player to move: 1 win, 0 draw, -1 loss
+//   37    halfmove clock, at most 255
+//   38-39 ply of the game the position was reached on
+const int RECORD_SIZE = 40;
+const int TRAINING_HEADER_SIZE = 8;
+
+// A record unpacked
+struct TrainingPosition {
+    int8_t squares[BoardState::SQUARES]; // BoardState piece codes, EMPTY if none
+    int variant;
+    int to_move;
+    int score;
+    int result;
+    int halfmove;
+    int ply;
+};
+
+// Pack the game's position into record, leaving the result as a draw
+void pack_position(const ChessGame& game, int variant, int score, int ply, uint8_t* record);
+
+// Set the result of a packed record from white's point of view
+void set_result(uint8_t* record, int white_result);
+
+// Unpack a record
+void unpack_position(const uint8_t* record, TrainingPosition& position);
+
+// Set game, which must be of the record's variant, to the recorded position.
+// Earlier positions are unknown, so none counts towards a repetition.
+// Returns false if the game's board does not have BoardState::SQUARES squares.
+bool load_position(ChessGame& game, const TrainingPosition& position);
+
+// Write a training file header into out, which has TRAINING_HEADER_SIZE bytes
+void training_header(uint8_t* out);
+
+// Return true if bytes starts with a training file header this code reads
+bool valid_training_header(const uint8_t* bytes);
+
+
+// Writes packed records on a background thread. Producers on any thread
+// hand over whole games with add; records are gathered into large buffers
+// and written out while the producers go on. With sharding, every
+// shard_records records go to a new file PREFIX-000.cgt, PREFIX-001.cgt...
+class TrainingWriter {
+
+public:
+
+    // Records gathered before a buffer is handed to the writer thread
+    static const int BUFFER_RECORDS = 16384;
+
+    TrainingWriter();
+
+    // Writes everything still buffered
+    ~TrainingWriter();
+
+    TrainingWriter(const TrainingWriter&) = delete;
+    TrainingWriter& operator=(const TrainingWriter&) = delete;
+
+    // Start writing to path, or to shards named after it when shard_records
+    // is positive. Returns false if the first file can't be created.
+    bool open(const std::string& path, long shard_records = 0);
+
+    // Queue count packed records. Blocks only if the writer falls far behind.
+    void add(const uint8_t* records, int count);
+
+    // Write everything out and close the files. Returns false if any write failed.
+    bool close();
+
+    // Number of records queued so far
+    long records() const { return _records; }
+
+private:
+
+    std::string _path;
+    long _shard_records;
+    int _shard;            // number of the file being written
+    long _in_shard;        // records in that file
+    int _fd;
+    bool _failed;
+    long _records;
+
+    std::mutex _lock;                   // guards the buffers and _closing
+    std::condition_variable _full;      // signalled when a buffer is handed over or on close
+    std::condition_variable _space;     // signalled when the writer takes a buffer
+    std::vector<uint8_t> _current;      // buffer being filled
+    std::deque<std::vector<uint8_t> > _pending; // buffers waiting to be written
+    bool _closing;
+    std::thread _thread;
+
+    // The writer thread
+    void write_loop();
+
+    // Write one buffer, starting new shards as needed
+    void write_buffer(const std::vector<uint8_t>& buffer);
+
+    // Open the next file and write its header
+    bool next_file();
+
+};
+
+#endif // TRAINING_DATA_H
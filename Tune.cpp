@@ -0,0 +1,8 @@
+#include <string>
+#include <vector>
+#include "Tuner.h"
+
+// Tune the evaluation weights on self-play records and write EvalWeights.h
+int main(int argc, char* argv[]) {
+    return Tuner::main(std::vector<std::string>(argv + 1, argv + argc));
+}
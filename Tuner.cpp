@@ -0,0 +1,316 @@
+#include <string>
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "ChessGame.h"
+#include "HillChess.h"
+#include "Variants.h"
+#include "TrainingData.h"
+#include "Tuner.h"
+
+using std::string;
+using std::vector;
+using std::ostream;
+
+// Positions worked on at once by gradient_range; small enough that the
+// evaluations and errors stay in cache between the passes over the columns
+static const int BLOCK = 1024;
+
+Tuner::Tuner(int threads) :
+  _pool(threads), _count(0), _skipped(0), _k(std::log(10.0) / 400), _steps(0),
+  _sums(_pool.size(), vector<double>(EVAL_TERMS + 1)), _games(_pool.size() * (SPOOKY_CHESS + 1), nullptr) {
+  int weights[EVAL_TERMS];
+  Evaluation::weights(weights);
+  for(int i = 0; i < EVAL_TERMS; i++){
+    _weights[i] = weights[i];
+    _moment[i] = _variance[i] = 0;
+  }
+}
+
+Tuner::~Tuner(){
+  for(size_t i = 0; i < _files.size(); i++)
+    munmap(_files[i].map, _files[i].size);
+  for(size_t i = 0; i < _games.size(); i++)
+    delete _games[i];
+}
+
+bool Tuner::add_file(const string& path){
+  int fd = open(path.c_str(), O_RDONLY);
+  if(fd < 0)
+    return false;
+  struct stat info;
+  if(fstat(fd, &info) != 0 || info.st_size < TRAINING_HEADER_SIZE){
+    close(fd);
+    return false;
+  }
+  void* map = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd); //the mapping stays valid
+  if(map == MAP_FAILED)
+    return false;
+  const uint8_t* bytes = static_cast<const uint8_t*>(map);
+  if(!valid_training_header(bytes)){
+    munmap(map, info.st_size);
+    return false;
+  }
+  madvise(map, info.st_size, MADV_SEQUENTIAL);
+  Mapped file = {map, (size_t)info.st_size, bytes + TRAINING_HEADER_SIZE,
+		 (long)((info.st_size - TRAINING_HEADER_SIZE) / RECORD_SIZE)};
+  _files.push_back(file);
+  _count += file.count;
+  return true;
+}
+
+void Tuner::load_range(const Mapped& file, long begin, long end, long first, double lambda, int worker){
+  ChessGame** games = &_games[worker * (SPOOKY_CHESS + 1)];
+  int terms[EVAL_TERMS];
+  TrainingPosition position;
+  long skipped = 0;
+  for(long r = begin; r < end; r++){
+    long i = first + r;
+    unpack_position(file.records + r * RECORD_SIZE, position);
+    int variant = position.variant;
+    if(variant < STANDARD_CHESS || variant > SPOOKY_CHESS){
+      for(int t = 0; t < EVAL_TERMS; t++)
+	_columns[t][i] = 0;
+      _targets[i] = 0.5f; //sigmoid(0), so it adds nothing to the gradient
+      skipped++;
+      continue;
+    }
+    if(games[variant] == nullptr)
+      games[variant] = create_game(variant, "");
+    ChessGame& game = *games[variant];
+    load_position(game, position);
+    Evaluation::features(game, terms);
+    if(variant == KING_OF_THE_HILL){ //as in HillSearch::evaluate
+      HillChess& hill = static_cast<HillChess&>(game);
+      int mine = hill.hill_distance(hill.player_turn());
+      int theirs = hill.hill_distance(hill.opponent());
+      if(mine >= 1 && mine <= 3)
+	terms[TERM_HILL_BONUS + mine - 1]++;
+      if(theirs >= 1 && theirs <= 3)
+	terms[TERM_HILL_BONUS + theirs - 1]--;
+    }
+    for(int t = 0; t < EVAL_TERMS; t++)
+      _columns[t][i] = terms[t];
+    double result = (position.result + 1) / 2.0;
+    double expected = 1 / (1 + std::exp(-_k * position.score));
+    _targets[i] = lambda * result + (1 - lambda) * expected;
+  }
+  _skipped += skipped;
+}
+
+void Tuner::load(double lambda){
+  for(int t = 0; t < EVAL_TERMS; t++)
+    _columns[t].assign(_count, 0);
+  _targets.assign(_count, 0);
+  _skipped = 0;
+  long first = 0;
+  long range = _count / (_pool.size() * 8) + 1;
+  for(size_t f = 0; f < _files.size(); f++){
+    const Mapped* file = &_files[f];
+    for(long begin = 0; begin < file->count; begin += range){
+      long end = begin + range < file->count ? begin + range : file->count;
+      _pool.submit([this, file, begin, end, first, lambda](int worker){
+	  load_range(*file, begin, end, first, lambda, worker);
+	});
+    }
+    first += file->count;
+  }
+  _pool.wait();
+}
+
+// The evaluations of a block are built up one weight at a time, and the
+// gradient is gathered the same way, so every inner loop runs down a
+// column with no branches
+void Tuner::gradient_range(long begin, long end, int worker){
+  double* sums = _sums[worker].data();
+  float evaluation[BLOCK], slope[BLOCK];
+  for(long block = begin; block < end; block += BLOCK){
+    int n = end - block < BLOCK ? end - block : BLOCK;
+    for(int i = 0; i < n; i++)
+      evaluation[i] = 0;
+    for(int t = 0; t < EVAL_TERMS; t++){
+      const int16_t* column = &_columns[t][block];
+      float weight = _weights[t];
+      for(int i = 0; i < n; i++)
+	evaluation[i] += weight * column[i];
+    }
+    const float* target = &_targets[block];
+    float k = _k;
+    double loss = 0;
+    for(int i = 0; i < n; i++){
+      float predicted = 1 / (1 + std::exp(-k * evaluation[i]));
+      float error = predicted - target[i];
+      loss += error * error;
+      slope[i] = error * predicted * (1 - predicted);
+    }
+    sums[EVAL_TERMS] += loss;
+    for(int t = 0; t < EVAL_TERMS; t++){
+      const int16_t* column = &_columns[t][block];
+      float sum = 0;
+      for(int i = 0; i < n; i++)
+	sum += slope[i] * column[i];
+      sums[t] += sum;
+    }
+  }
+}
+
+double Tuner::gradient(double* gradient){
+  for(size_t w = 0; w < _sums.size(); w++)
+    _sums[w].assign(EVAL_TERMS + 1, 0);
+  long range = _count / (_pool.size() * 8) + 1;
+  for(long begin = 0; begin < _count; begin += range){
+    long end = begin + range < _count ? begin + range : _count;
+    _pool.submit([this, begin, end](int worker){ gradient_range(begin, end, worker); });
+  }
+  _pool.wait();
+  double loss = 0;
+  for(int t = 0; t < EVAL_TERMS; t++)
+    gradient[t] = 0;
+  for(size_t w = 0; w < _sums.size(); w++){
+    for(int t = 0; t < EVAL_TERMS; t++)
+      gradient[t] += _sums[w][t];
+    loss += _sums[w][EVAL_TERMS];
+  }
+  //d(error^2)/dweight = 2 * error * predicted * (1 - predicted) * k * count
+  for(int t = 0; t < EVAL_TERMS; t++)
+    gradient[t] *= 2 * _k / (_count > 0 ? _count : 1);
+  return _count > 0 ? loss / _count : 0;
+}
+
+double Tuner::loss(){
+  double unused[EVAL_TERMS];
+  return gradient(unused);
+}
+
+double Tuner::epoch(double rate){
+  const double beta1 = 0.9, beta2 = 0.999, epsilon = 1e-12;
+  double g[EVAL_TERMS];
+  double loss = gradient(g);
+  _steps++;
+  for(int t = 0; t < EVAL_TERMS; t++){
+    if(t == TERM_MINOR_BASE || t == TERM_QUEEN_BASE)
+      continue; //they count exactly where material does, which takes them up
+    _moment[t] = beta1 * _moment[t] + (1 - beta1) * g[t];
+    _variance[t] = beta2 * _variance[t] + (1 - beta2) * g[t] * g[t];
+    double moment = _moment[t] / (1 - std::pow(beta1, _steps));
+    double variance = _variance[t] / (1 - std::pow(beta2, _steps));
+    _weights[t] -= rate * moment / (std::sqrt(variance) + epsilon);
+  }
+  return loss;
+}
+
+// Write count weights starting at term as a C array, padded with fixed values
+static void write_array(ostream& out, const char* name, const double* weights, int term, int count,
+			const char* before, const char* after){
+  out << "static const int " << name << "[] = {" << before;
+  for(int i = 0; i < count; i++)
+    out << (i > 0 ? ", " : "") << std::lround(weights[term + i]);
+  out << after << "};\n";
+}
+
+void Tuner::write_header(ostream& out) const{
+  const double* w = _weights;
+  out << "// Evaluation weights in centipawns, used by Evaluation and HillSearch.\n"
+      << "// Generated by tune; regenerate with it rather than editing by hand.\n"
+      << "#ifndef EVAL_WEIGHTS_H\n"
+      << "#define EVAL_WEIGHTS_H\n"
+      << "\n"
+      << "// Material values indexed by PieceEnum. The king is never traded and the\n"
+      << "// ghost belongs to no one, so neither counts towards material.\n";
+  write_array(out, "PIECE_VALUES", w, TERM_MATERIAL, 5, "", ", 0, 0");
+  out << "\n"
+      << "// Placement: per rank advanced and per half square away from the middle\n"
+      << "static const int PAWN_ADVANCE = " << std::lround(w[TERM_PAWN_ADVANCE]) << ";\n"
+      << "static const int PAWN_CENTER = " << std::lround(w[TERM_PAWN_CENTER]) << ";\n"
+      << "static const int MINOR_BASE = " << std::lround(w[TERM_MINOR_BASE]) << ";\n"
+      << "static const int MINOR_CENTER = " << std::lround(w[TERM_MINOR_CENTER]) << ";\n"
+      << "static const int QUEEN_BASE = " << std::lround(w[TERM_QUEEN_BASE]) << ";\n"
+      << "static const int QUEEN_CENTER = " << std::lround(w[TERM_QUEEN_CENTER]) << ";\n"
+      << "static const int KING_ADVANCE = " << std::lround(w[TERM_KING_ADVANCE]) << ";\n"
+      << "\n"
+      << "// Pawn structure\n"
+      << "static const int DOUBLED_PAWN = " << std::lround(w[TERM_DOUBLED_PAWN]) << ";\n"
+      << "static const int ISOLATED_PAWN = " << std::lround(w[TERM_ISOLATED_PAWN]) << ";\n";
+  write_array(out, "PASSED_PAWN", w, TERM_PASSED_PAWN, 6, "0, ", "");
+  out << "static const int FREE_PASSED_PAWN = " << std::lround(w[TERM_FREE_PASSED_PAWN]) << ";\n"
+      << "\n"
+      << "// King of the Hill: bonus for a king this many steps from the hill\n";
+  write_array(out, "HILL_BONUS", w, TERM_HILL_BONUS, 3, "0, ", "");
+  out << "\n"
+      << "#endif // EVAL_WEIGHTS_H\n";
+}
+
+int Tuner::main(const vector<string>& args){
+  int epochs = 200;
+  double rate = 1, lambda = 0.5, k = 0;
+  int threads = ThreadPool::hardware_threads();
+  string output = "EvalWeights.h";
+  vector<string> paths;
+  for(size_t i = 0; i < args.size(); i++){
+    bool has_value = i + 1 < args.size();
+    if(args[i] == "--epochs" && has_value)
+      epochs = std::atoi(args[++i].c_str());
+    else if(args[i] == "--rate" && has_value)
+      rate = std::atof(args[++i].c_str());
+    else if(args[i] == "--lambda" && has_value)
+      lambda = std::atof(args[++i].c_str());
+    else if(args[i] == "--k" && has_value)
+      k = std::atof(args[++i].c_str());
+    else if(args[i] == "--threads" && has_value)
+      threads = std::atoi(args[++i].c_str());
+    else if(args[i] == "--out" && has_value)
+      output = args[++i];
+    else
+      paths.push_back(args[i]);
+  }
+  if(paths.empty() || epochs < 0 || lambda < 0 || lambda > 1){
+    std::cerr << "Usage: tune [--epochs N] [--rate X] [--lambda X] [--k X] [--threads N] [--out FILE] <training file>...\n";
+    return 1;
+  }
+
+  Tuner tuner(threads);
+  if(k > 0)
+    tuner._k = k;
+  for(size_t i = 0; i < paths.size(); i++){
+    if(!tuner.add_file(paths[i]))
+      std::cerr << "Skipping " << paths[i] << ": not a training file\n";
+  }
+  if(tuner.size() == 0){
+    std::cerr << "No positions to tune on\n";
+    return 1;
+  }
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  tuner.load(lambda);
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::cout << "positions " << tuner.size() << " skipped " << tuner.skipped()
+	    << " load " << seconds << "s" << std::endl;
+
+  start = std::chrono::steady_clock::now();
+  for(int e = 0; e < epochs; e++){
+    double loss = tuner.epoch(rate);
+    if(e % 10 == 0)
+      std::cout << "epoch " << e << " loss " << loss << std::endl;
+  }
+  seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::cout << "loss " << tuner.loss() << " epochs " << epochs << " time " << seconds << "s";
+  if(epochs > 0)
+    std::cout << " per epoch " << seconds / epochs << "s";
+  std::cout << std::endl;
+
+  std::ofstream file(output);
+  if(!file.is_open()){
+    std::cerr << "Can't write " << output << "\n";
+    return 1;
+  }
+  tuner.write_header(file);
+  return 0;
+}
@@ -0,0 +1,106 @@
+#ifndef TUNER_H
+#define TUNER_H
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <atomic>
+#include <cstdint>
+#include "Evaluation.h"
+#include "ThreadPool.h"
+
+class ChessGame;
+
+// Tunes the evaluation weights (EvalWeights.h) against self-play records
+// (TrainingData.h) by logistic regression: the predicted result of a
+// position is sigmoid(k * evaluation), and the loss is its squared error
+// against a blend of the game's result and the recorded search score.
+//
+// The record files are memory-mapped, and every position is turned once
+// into how often each weight counts in it. Those counts are kept weight by
+// weight in contiguous columns, so an epoch is a few multiply-add loops
+// over plain arrays that the compiler can vectorize. Positions are split
+// into ranges on a ThreadPool; every worker sums its own gradient.
+class Tuner {
+
+public:
+
+    explicit Tuner(int threads);
+
+    // Unmaps the files and frees the games
+    ~Tuner();
+
+    Tuner(const Tuner&) = delete;
+    Tuner& operator=(const Tuner&) = delete;
+
+    // Map a training file. Returns false if it can't be read or is not one.
+    bool add_file(const std::string& path);
+
+    // Number of positions in the mapped files
+    long size() const { return _count; }
+
+    // Work out the weight counts and targets of every position. lambda is
+    // how much the game result counts against the search score, from 0 to 1.
+    void load(double lambda);
+
+    // Number of records load skipped because their variant is unknown
+    long skipped() const { return _skipped; }
+
+    // Mean loss of the current weights
+    double loss();
+
+    // Take one step of gradient descent (Adam) over every position with the
+    // given step size in centipawns. Returns the mean loss before the step.
+    double epoch(double rate);
+
+    // Write the current weights, rounded, in the layout of EvalWeights.h
+    void write_header(std::ostream& out) const;
+
+    // Command-line entry: tune [--epochs N] [--rate X] [--lambda X] [--k X]
+    // [--threads N] [--out FILE] <training file>...
+    static int main(const std::vector<std::string>& args);
+
+private:
+
+    // A mapped training file
+    struct Mapped {
+        void* map;
+        size_t size;
+        const uint8_t* records;
+        long count;
+    };
+
+    ThreadPool _pool;
+    std::vector<Mapped> _files;
+    long _count;
+    std::atomic<long> _skipped;
+
+    std::vector<int16_t> _columns[EVAL_TERMS]; // per weight, its count in every position
+    std::vector<float> _targets;                // expected result of every position, 0 to 1
+
+    double _k;                    // sigmoid scale, per centipawn
+    double _weights[EVAL_TERMS];
+    double _moment[EVAL_TERMS];   // Adam's running mean of the gradient
+    double _variance[EVAL_TERMS]; // and of its square
+    int _steps;
+
+    // Per worker: the gradient and the loss summed over its ranges
+    std::vector<std::vector<double> > _sums;
+
+    // Per worker, one game of each variant (indexed by GameName) that
+    // records are loaded into to be counted
+    std::vector<ChessGame*> _games;
+
+    // Fill in positions [begin, end) of file, numbered from first
+    void load_range(const Mapped& file, long begin, long end, long first, double lambda, int worker);
+
+    // Add the gradient and loss of positions [begin, end) to the worker's sums
+    void gradient_range(long begin, long end, int worker);
+
+    // Run gradient_range over every position; gradient gets the mean
+    // gradient, and the mean loss is returned
+    double gradient(double* gradient);
+
+};
+
+#endif // TUNER_H
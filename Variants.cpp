@@ -0,0 +1,42 @@
+#include <string>
+#include <fstream>
+#include "ChessGame.h"
+#include "HillChess.h"
+#include "SpookyChess.h"
+#include "Variants.h"
+
+using std::string;
+
+ChessGame* create_game(int game_choice, const string& filename) {
+    bool load = !filename.empty();
+    switch (game_choice) {
+    case STANDARD_CHESS:
+        return load ? new ChessGame(filename, STANDARD_CHESS) : new ChessGame();
+    case KING_OF_THE_HILL:
+        return load ? new HillChess(filename, KING_OF_THE_HILL) : new HillChess();
+    case SPOOKY_CHESS:
+        return load ? new SpookyChess(filename, SPOOKY_CHESS) : new SpookyChess();
+    }
+    return nullptr;
+}
+
+int detect_game(const string& filename) {
+    std::ifstream file(filename);
+    string token;
+    if (!(file >> token))
+        return 0;
+    for (int g = STANDARD_CHESS; g <= SPOOKY_CHESS; g++) {
+        if (token == game_token(g))
+            return g;
+    }
+    return 0;
+}
+
+const char* game_token(int game_choice) {
+    switch (game_choice) {
+    case STANDARD_CHESS: return "chess";
+    case KING_OF_THE_HILL: return "king";
+    case SPOOKY_CHESS: return "spooky";
+    }
+    return "";
+}
@@ -0,0 +1,22 @@
+#ifndef VARIANTS_H
+#define VARIANTS_H
+
+#include <string>
+#include "ChessGame.h"
+
+// Game variant enumeration
+enum GameName {STANDARD_CHESS = 1, KING_OF_THE_HILL, SPOOKY_CHESS};
+
+// Create the chosen game variant, loaded from filename unless it is empty.
+// Returns nullptr for an unknown variant, and throws like the game
+// constructors when the file can't be loaded. Caller owns the result.
+ChessGame* create_game(int game_choice, const std::string& filename);
+
+// Read the header token of a saved game ("chess", "king" or "spooky") and
+// return the matching GameName, or 0 if the file can't be read or is unknown
+int detect_game(const std::string& filename);
+
+// Return the header token written for a GameName
+const char* game_token(int game_choice);
+
+#endif // VARIANTS_H
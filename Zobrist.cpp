@@ -0,0 +1,46 @@
+#include <cstdint>
+#include <vector>
+#include "Piece.h"
+#include "Zobrist.h"
+
+// Number of piece types, owners (White, Black and the ghost's NO_ONE) and squares
+static const int TYPES = GHOST_ENUM + 1;
+static const int OWNERS = NO_ONE + 1;
+static const int SQUARES = 64;
+
+// The key table, filled once from a fixed seed so hashes are the same in
+// every run and can be stored on disk
+struct ZobristKeys {
+  uint64_t pieces[OWNERS][TYPES][SQUARES];
+  uint64_t black;
+
+  ZobristKeys(){
+    uint64_t state = 0x9E3779B97F4A7C15ULL;
+    for(int o = 0; o < OWNERS; o++)
+      for(int t = 0; t < TYPES; t++)
+	for(int s = 0; s < SQUARES; s++)
+	  pieces[o][t][s] = next(state);
+    black = next(state);
+  }
+
+  // splitmix64 generator
+  static uint64_t next(uint64_t& state){
+    uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+  }
+};
+
+static const ZobristKeys& keys(){
+  static const ZobristKeys table;
+  return table;
+}
+
+uint64_t Zobrist::piece(int piece_type, Player owner, int square){
+  return keys().pieces[owner][piece_type][square];
+}
+
+uint64_t Zobrist::black_to_move(){
+  return keys().black;
+}
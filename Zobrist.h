@@ -0,0 +1,23 @@
+#ifndef ZOBRIST_H
+#define ZOBRIST_H
+
+#include <cstdint>
+#include "Enumerations.h"
+
+// Random keys for hashing positions. A position's hash is the XOR of the
+// keys of its pieces, plus black_to_move() when it is Black's turn, so it
+// can be updated piece by piece as moves are made and taken back.
+class Zobrist {
+
+public:
+
+    // Key for a piece of the given type and owner on a 1D board index.
+    // Boards of up to 64 squares are supported.
+    static uint64_t piece(int piece_type, Player owner, int square);
+
+    // Key added when Black is to move
+    static uint64_t black_to_move();
+
+};
+
+#endif // ZOBRIST_H